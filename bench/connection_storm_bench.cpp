@@ -0,0 +1,280 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Connection storm benchmark of the accept path: a server runs on a child process (with each I/O backend) while a few threads open thousands of
+// connections to it at once, timing each connect. Every connection then sends a /ping and waits for the pong, which only comes after the server has
+// accepted the connection and given it to a reactor, so the time until the last pong is how long the server took to take the whole storm in.
+// Usage: connection-storm-bench [connections] [connecting threads]
+
+# include "../src/server/main_server.hpp"
+# include "../src/messaging.hpp"
+
+# include <iostream>
+# include <iomanip>
+# include <string>
+
+# include <vector>
+# include <algorithm>
+
+# include <thread>
+# include <atomic>
+
+# include <chrono>
+
+# include <cstdint>
+# include <cstdlib>
+# include <csignal>
+
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include <sys/resource.h>
+# include <arpa/inet.h>
+# include <netinet/in.h>
+
+// How long the server has to start listening before the run is given up.
+constexpr int64_t startup_timeout = 5000000000;
+
+// A way of running the server.
+struct bench_setup {
+    const char *name;
+    io_backend backend;
+    bool sharded;
+};
+
+// Results of a run.
+struct bench_result {
+    size_t connected;
+    size_t answered;
+    double connect_seconds;
+    double answer_seconds;
+    int64_t p50_connect;
+    int64_t p99_connect;
+    int64_t max_connect;
+};
+
+// Returns the current time in nanoseconds.
+static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// ==============================================================================================================================================================
+// Server =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Runs the server on a child process (with it's output discarded), returns the child's pid.
+static pid_t start_server(int port, const bench_setup &setup) {
+
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    if(null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+
+    server srv(port, setup.backend, setup.sharded);
+    if(srv.get_status() < 0)
+        _exit(1);
+    srv.handle();
+    _exit(0);
+
+}
+
+// Opens a connection to the server, returns -1 if it fails.
+static int connect_to(int port) {
+
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(socket_fd < 0)
+        return -1;
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(connect(socket_fd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        close(socket_fd);
+        return -1;
+    }
+
+    return socket_fd;
+
+}
+
+// Waits until the server is listening, returns false if it never does.
+static bool wait_for_server(int port) {
+
+    int64_t start = now();
+    while(now() - start < startup_timeout) {
+        int socket_fd = connect_to(port);
+        if(socket_fd >= 0) {
+            close(socket_fd);
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+
+}
+
+// Waits for the first numbered frame on a connection (the pong), returns false if the connection is lost first.
+static bool wait_for_reply(int socket_fd) {
+
+    frame_parser parser;
+    frame_header frame;
+    std::string message;
+    char buffer[max_block_size];
+
+    while(true) {
+        int parsed = parser.next(frame, message);
+        if(parsed < 0)
+            return false;
+        if(parsed > 0 && (frame.flags & ff_Data))
+            return true;
+        if(parsed > 0)
+            continue;
+        ssize_t received = recv(socket_fd, buffer, sizeof(buffer), 0);
+        if(received <= 0)
+            return false;
+        parser.feed(buffer, received);
+    }
+
+}
+
+// ==============================================================================================================================================================
+// Benchmark ====================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Opens the connections all at once from a few threads, then pings through every one of them.
+static bench_result storm(int port, size_t connection_count, size_t thread_count) {
+
+    std::vector<int> sockets(connection_count, -1);
+    std::vector<int64_t> latencies(connection_count, 0);
+    std::atomic<size_t> answered(0);
+
+    // Each thread takes every thread_count-th connection.
+    auto connect_all = [&](size_t first) {
+        for(size_t i = first; i < connection_count; i += thread_count) {
+            int64_t start = now();
+            sockets[i] = connect_to(port);
+            latencies[i] = now() - start;
+        }
+    };
+    auto ping_all = [&](size_t first) {
+        for(size_t i = first; i < connection_count; i += thread_count) {
+            if(sockets[i] < 0)
+                continue;
+            send_message(sockets[i], "/ping");
+            if(wait_for_reply(sockets[i]))
+                answered++;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    int64_t start = now();
+    for(size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(connect_all, i);
+    for(auto iter = threads.begin(); iter != threads.end(); iter++)
+        iter->join();
+    int64_t connected_time = now();
+
+    threads.clear();
+    for(size_t i = 0; i < thread_count; i++)
+        threads.emplace_back(ping_all, i);
+    for(auto iter = threads.begin(); iter != threads.end(); iter++)
+        iter->join();
+    int64_t answered_time = now();
+
+    bench_result result = {};
+    result.connected = std::count_if(sockets.begin(), sockets.end(), [](int socket_fd) { return socket_fd >= 0; });
+    result.answered = answered;
+    result.connect_seconds = (connected_time - start) / 1e9;
+    result.answer_seconds = (answered_time - start) / 1e9;
+
+    std::sort(latencies.begin(), latencies.end());
+    result.p50_connect = latencies[latencies.size() / 2];
+    result.p99_connect = latencies[latencies.size() * 99 / 100];
+    result.max_connect = latencies.back();
+
+    for(auto iter = sockets.begin(); iter != sockets.end(); iter++)
+        if(*iter >= 0)
+            close(*iter);
+
+    return result;
+
+}
+
+// Runs the storm against a server with the given setup and prints the results.
+static void run(const bench_setup &setup, int port, size_t connection_count, size_t thread_count) {
+
+    pid_t pid = start_server(port, setup);
+    if(pid < 0 || !wait_for_server(port)) {
+        std::cout << std::setw(10) << setup.name << "  server didn't start" << std::endl;
+        if(pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return;
+    }
+
+    bench_result result = storm(port, connection_count, thread_count);
+
+    kill(pid, SIGINT);
+    waitpid(pid, nullptr, 0);
+
+    std::cout << std::setw(10) << setup.name
+              << std::setw(8) << result.connected << " connected in " << std::setw(6) << result.connect_seconds * 1000.0 << " ms ("
+              << std::setw(8) << result.connected / result.connect_seconds << " conn/s)"
+              << "  connect p50 " << std::setw(7) << result.p50_connect / 1000.0 << " us  p99 " << std::setw(8) << result.p99_connect / 1000.0
+              << " us  max " << std::setw(8) << result.max_connect / 1000.0 << " us"
+              << std::setw(8) << result.answered << " answered after " << std::setw(6) << result.answer_seconds * 1000.0 << " ms" << std::endl;
+
+}
+
+int main(int argc, char **argv) {
+
+    size_t connection_count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10000;
+    size_t thread_count = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 4;
+    if(connection_count == 0 || thread_count == 0) {
+        std::cerr << "Usage: " << argv[0] << " [connections] [connecting threads]" << std::endl;
+        return 1;
+    }
+
+    // Both sides of every connection need a descriptor (the server's on the child), so the limit must fit the connections plus some slack.
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < connection_count + 64) {
+        limit.rlim_cur = std::min<rlim_t>(limit.rlim_max, connection_count + 64);
+        setrlimit(RLIMIT_NOFILE, &limit);
+        if(limit.rlim_cur < connection_count + 64) {
+            connection_count = limit.rlim_cur - 64;
+            std::cout << "Descriptor limit too low, using " << connection_count << " connections" << std::endl;
+        }
+    }
+
+    // Lost connections must not kill the benchmark.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    const bench_setup setups[] = {
+        { "epoll", ib_Epoll, false },
+        { "sharded", ib_Epoll, true },
+        { "io_uring", ib_Io_uring, false },
+    };
+
+    // Each setup gets it's own port, so connections still closing from a run don't get in the way of the next.
+    int base_port = 20000 + getpid() % 20000;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << connection_count << " connections from " << thread_count << " threads" << std::endl;
+
+    for(size_t i = 0; i < sizeof(setups) / sizeof(setups[0]); i++)
+        run(setups[i], base_port + i, connection_count, thread_count);
+
+    return 0;
+
+}
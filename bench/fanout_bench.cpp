@@ -0,0 +1,143 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Benchmark of sending a message to a large channel: each member's send queue gets the message the way server::fan_out does, with the prefix and the
+// payload shared by every member through refcounted buffers, next to giving each member a copy of the rendered message. Counts the allocations and
+// the time per message, including the members' reactors taking the messages from their queues and releasing them.
+// Usage: fanout-bench [members] [messages] [payload size]
+
+# include "../src/server/outgoing_message.hpp"
+# include "../src/server/message_buffer.hpp"
+# include "../src/server/spsc_ring.hpp"
+
+# include <iostream>
+# include <iomanip>
+# include <string>
+
+# include <vector>
+# include <new>
+
+# include <atomic>
+# include <chrono>
+
+# include <cstdint>
+# include <cstdlib>
+
+// Amount of messages each member's send queue holds, they're taken after each message so it never fills.
+constexpr size_t member_queue_capacity = 16;
+
+// Amount of allocations and bytes allocated through operator new since the program started.
+static std::atomic<uint64_t> allocation_count(0);
+static std::atomic<uint64_t> allocated_bytes(0);
+
+// ==============================================================================================================================================================
+// Allocation counting ==========================================================================================================================================
+// ==============================================================================================================================================================
+
+// Only the plain forms allocate and free, every other form forwards to them, so the new and delete that end up being called always match (they're
+// not inlined, so the compiler doesn't see malloc and free in place of the array forms that forward to them).
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocation_count++;
+    allocated_bytes += size;
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept { std::free(memory); }
+
+void *operator new[](size_t size) { return ::operator new(size); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept { try { return ::operator new(size); } catch(...) { return nullptr; } }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { try { return ::operator new(size); } catch(...) { return nullptr; } }
+
+void operator delete[](void *memory) noexcept { ::operator delete(memory); }
+void operator delete(void *memory, size_t) noexcept { ::operator delete(memory); }
+void operator delete[](void *memory, size_t) noexcept { ::operator delete(memory); }
+
+// ==============================================================================================================================================================
+// Benchmark ====================================================================================================================================================
+// ==============================================================================================================================================================
+
+// A channel member, with it's send queue and what it's reactor takes from it.
+struct bench_member {
+    bench_member() : send_queue(member_queue_capacity) {}
+    spsc_ring<outgoing_message> send_queue;
+};
+
+// Returns the current time in nanoseconds.
+static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// Takes every member's messages like their reactors do and releases them.
+static void drain(std::vector<bench_member> &members, std::vector<outgoing_message> &taken) {
+    for(auto iter = members.begin(); iter != members.end(); iter++) {
+        taken.clear();
+        iter->send_queue.pop_batch(taken, member_queue_capacity);
+    }
+    taken.clear();
+}
+
+// Sends the messages to every member, sharing them or copying them, and prints the allocations and time per message.
+static void run(const std::string &name, std::vector<bench_member> &members, size_t message_count, const std::string &prefix_text, const std::string &payload_text, bool shared) {
+
+    std::vector<outgoing_message> taken;
+    taken.reserve(member_queue_capacity);
+
+    uint64_t allocations_before = allocation_count;
+    uint64_t bytes_before = allocated_bytes;
+    int64_t started = now();
+
+    for(size_t m = 0; m < message_count; m++) {
+
+        if(shared) {
+            // Rendered once, every member gets a reference (what server::send_request and server::fan_out do).
+            message_handle prefix(prefix_text);
+            message_handle payload(payload_text);
+            outgoing_message rendered(prefix, payload);
+            for(auto iter = members.begin(); iter != members.end(); iter++)
+                iter->send_queue.push(rendered);
+        } else {
+            // Each member gets it's own copy of the rendered message.
+            std::string rendered = prefix_text + payload_text;
+            for(auto iter = members.begin(); iter != members.end(); iter++)
+                iter->send_queue.push(outgoing_message(rendered));
+        }
+
+        drain(members, taken);
+
+    }
+
+    int64_t elapsed = now() - started;
+    double allocations = (double)(allocation_count - allocations_before) / message_count;
+    double bytes = (double)(allocated_bytes - bytes_before) / message_count;
+
+    std::cout << std::left << std::setw(8) << name << std::right << ": " << std::setw(10) << allocations << " allocations, " << std::setw(12) << bytes / 1024
+    << " KB allocated, " << std::setw(10) << elapsed / 1000.0 / message_count << "us per message" << std::endl;
+
+}
+
+int main(int argc, char **argv) {
+
+    size_t member_count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 50000;
+    size_t message_count = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 50;
+    size_t payload_size = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 1024;
+    if(member_count == 0 || message_count == 0) {
+        std::cerr << "Usage: " << argv[0] << " [members] [messages] [payload size]" << std::endl;
+        return 1;
+    }
+
+    std::vector<bench_member> members(member_count);
+    std::string prefix_text = "#channel nickname: ";
+    std::string payload_text(payload_size, 'x');
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << member_count << " members, " << message_count << " messages of " << payload_size << " bytes" << std::endl;
+
+    run("shared", members, message_count, prefix_text, payload_text, true);
+    run("copied", members, message_count, prefix_text, payload_text, false);
+
+    return 0;
+
+}
@@ -0,0 +1,182 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Contention benchmark of the request queue: N producers push M items each while a single consumer drains them, comparing the lock-free mpsc_queue
+// (drained in batches, like the dispatcher does) with the mutex and std::queue it replaced (one item per lock, like the old dispatcher).
+// Usage: mpsc-queue-bench [items per producer] [max producers]
+
+# include "../src/server/mpsc_queue.hpp"
+
+# include <iostream>
+# include <iomanip>
+# include <string>
+
+# include <vector>
+# include <queue>
+# include <algorithm>
+
+# include <thread>
+# include <mutex>
+# include <atomic>
+
+# include <chrono>
+
+# include <cstdint>
+# include <cstdlib>
+
+// Capacity of the lock-free queue and size of the batches the consumer takes, the same as the server's.
+constexpr size_t queue_capacity = 65536;
+constexpr size_t batch_size = 256;
+
+// Item pushed by the producers, stamped with when it was pushed.
+struct bench_item {
+    int64_t pushed;
+    unsigned producer;
+};
+
+// Results of a run.
+struct bench_result {
+    double items_per_second;
+    int64_t p50_latency;
+    int64_t p99_latency;
+};
+
+// Returns the current time in nanoseconds.
+static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// ==============================================================================================================================================================
+// Queues =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// The lock-free queue, full pushes are retried like a reactor would have to.
+class lock_free_queue
+{
+
+    public:
+
+        lock_free_queue() : queue(queue_capacity) {}
+
+        void push(const bench_item &item) {
+            while(!this->queue.push(item))
+                std::this_thread::yield();
+        }
+
+        size_t pop(std::vector<bench_item> &items) { return this->queue.pop_batch(items, batch_size); }
+
+    private:
+
+        mpsc_queue<bench_item> queue;
+
+};
+
+// The mutex and std::queue used before, the consumer takes one item per lock.
+class locked_queue
+{
+
+    public:
+
+        void push(const bench_item &item) {
+            std::lock_guard<std::mutex> lock(this->updating);
+            this->queue.push(item);
+        }
+
+        size_t pop(std::vector<bench_item> &items) {
+            std::lock_guard<std::mutex> lock(this->updating);
+            if(this->queue.empty())
+                return 0;
+            items.push_back(this->queue.front());
+            this->queue.pop();
+            return 1;
+        }
+
+    private:
+
+        std::mutex updating;
+        std::queue<bench_item> queue;
+
+};
+
+// ==============================================================================================================================================================
+// Benchmark ====================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Pushes items_per_producer items from each producer and drains them on the current thread, measuring the throughput and how long items waited.
+template <typename Q>
+static bench_result run(unsigned producer_count, size_t items_per_producer) {
+
+    Q queue;
+    std::atomic_bool start(false);
+
+    std::vector<std::thread> producers;
+    for(unsigned p = 0; p < producer_count; p++) {
+        producers.push_back(std::thread([&queue, &start, p, items_per_producer]() {
+            while(!start)
+                std::this_thread::yield();
+            for(size_t i = 0; i < items_per_producer; i++)
+                queue.push(bench_item{ now(), p });
+        }));
+    }
+
+    size_t total = producer_count * items_per_producer;
+    std::vector<int64_t> latencies;
+    latencies.reserve(total);
+    std::vector<bench_item> items;
+    items.reserve(batch_size);
+
+    int64_t started = now();
+    start = true;
+
+    // Drains every item, yielding while there's none so the producers can run on machines with few cores.
+    while(latencies.size() < total) {
+        items.clear();
+        if(queue.pop(items) == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        int64_t popped = now();
+        for(auto iter = items.begin(); iter != items.end(); iter++)
+            latencies.push_back(popped - iter->pushed);
+    }
+
+    int64_t elapsed = now() - started;
+    for(auto iter = producers.begin(); iter != producers.end(); iter++)
+        iter->join();
+
+    std::sort(latencies.begin(), latencies.end());
+
+    bench_result result;
+    result.items_per_second = total / (elapsed / 1e9);
+    result.p50_latency = latencies[latencies.size() / 2];
+    result.p99_latency = latencies[latencies.size() * 99 / 100];
+    return result;
+
+}
+
+// Prints a line of results.
+static void print(const std::string &name, unsigned producer_count, const bench_result &result) {
+    std::cout << std::left << std::setw(12) << name << std::right << std::setw(4) << producer_count << " producers: " << std::setw(12) << (uint64_t)result.items_per_second
+    << " items/s, p50 " << std::setw(8) << result.p50_latency / 1000.0 << "us, p99 " << std::setw(8) << result.p99_latency / 1000.0 << "us" << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    size_t items_per_producer = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 200000;
+    unsigned max_producers = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 8;
+    if(items_per_producer == 0 || max_producers == 0) {
+        std::cerr << "Usage: " << argv[0] << " [items per producer] [max producers]" << std::endl;
+        return 1;
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << items_per_producer << " items per producer, " << std::thread::hardware_concurrency() << " cores" << std::endl;
+
+    for(unsigned producer_count = 1; producer_count <= max_producers; producer_count *= 2) {
+        print("mpsc_queue", producer_count, run<lock_free_queue>(producer_count, items_per_producer));
+        print("mutex+queue", producer_count, run<locked_queue>(producer_count, items_per_producer));
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,124 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Benchmark of finding clients by their nicknames: fills the server's nickname index with 10 to 100k clients and times lookups of nicknames
+// that are used (kick, mute, whois) and that are not (changing nickname), next to the linear scan over every client that the index replaced.
+// Usage: nickname-index-bench [lookups]
+
+# include "../src/server/main_server.hpp"
+
+# include <iostream>
+# include <iomanip>
+# include <string>
+
+# include <vector>
+# include <set>
+# include <random>
+# include <algorithm>
+
+# include <chrono>
+
+# include <cstdint>
+# include <cstdlib>
+
+// Amounts of connected clients measured.
+static const size_t client_counts[] = { 10, 1000, 10000, 100000 };
+
+// Work done by the linear scan on each amount of clients, so the large ones don't take minutes (compared characters are about the same per client).
+constexpr size_t scan_budget = 20000000;
+
+// Stands for a connected client on the linear scan, the nickname was copied on every call like connected_client::get_nickname used to.
+struct scanned_client {
+    std::string nickname;
+    std::string get_nickname() const { return this->nickname; }
+};
+
+// Keeps the compiler from removing the lookups.
+static volatile uintptr_t sink;
+
+// Returns the current time in nanoseconds.
+static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// Times lookups of the given nicknames on the index, returns the average time of a lookup (in nanoseconds).
+static double time_index(const nickname_index &index, const std::vector<std::string> &queries, size_t lookups) {
+
+    int64_t started = now();
+    uintptr_t found = 0;
+    for(size_t i = 0; i < lookups; i++) {
+        auto iter = index.find(queries[i % queries.size()]);
+        if(iter != index.end())
+            found += (uintptr_t)iter->second;
+    }
+    int64_t elapsed = now() - started;
+
+    sink = found;
+    return (double)elapsed / lookups;
+
+}
+
+// Times the linear scan the index replaced, returns the average time of a lookup (in nanoseconds).
+static double time_scan(const std::set<scanned_client*> &clients, const std::vector<std::string> &queries, size_t lookups) {
+
+    int64_t started = now();
+    uintptr_t found = 0;
+    for(size_t i = 0; i < lookups; i++) {
+        const std::string &nickname = queries[i % queries.size()];
+        for(auto iter = clients.begin(); iter != clients.end(); iter++) {
+            if((*iter)->get_nickname() == nickname) {
+                found += (uintptr_t)*iter;
+                break;
+            }
+        }
+    }
+    int64_t elapsed = now() - started;
+
+    sink = found;
+    return (double)elapsed / lookups;
+
+}
+
+int main(int argc, char **argv) {
+
+    size_t lookups = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    if(lookups == 0) {
+        std::cerr << "Usage: " << argv[0] << " [lookups]" << std::endl;
+        return 1;
+    }
+
+    std::mt19937 random(42);
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << lookups << " lookups on the index per amount of clients" << std::endl;
+
+    for(size_t client_count : client_counts) {
+
+        // Clients keep the nickname they connect with ("socket n") or choose their own, like on the server.
+        nickname_index index;
+        std::set<scanned_client*> scanned;
+        std::vector<scanned_client> storage(client_count);
+        std::vector<std::string> used, unused;
+        for(size_t i = 0; i < client_count; i++) {
+            storage[i].nickname = (i % 2 == 0) ? "socket " + std::to_string(i + 7) : "user" + std::to_string(random());
+            index[storage[i].nickname] = (connected_client*)(uintptr_t)(i + 1);
+            scanned.insert(&storage[i]);
+            used.push_back(storage[i].nickname);
+            unused.push_back("free" + std::to_string(random()));
+        }
+        std::shuffle(used.begin(), used.end(), random);
+
+        double index_used = time_index(index, used, lookups);
+        double index_unused = time_index(index, unused, lookups);
+
+        size_t scan_lookups = std::max<size_t>(1, std::min(lookups, scan_budget / client_count));
+        double scan_used = time_scan(scanned, used, scan_lookups);
+        double scan_unused = time_scan(scanned, unused, scan_lookups);
+
+        std::cout << std::setw(7) << client_count << " clients: index " << std::setw(8) << index_used << "ns (used), " << std::setw(8) << index_unused
+        << "ns (unused) | linear scan " << std::setw(12) << scan_used << "ns (used), " << std::setw(12) << scan_unused << "ns (unused)" << std::endl;
+
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,314 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Benchmark of executing requests on per-channel strands against the old serial dispatch: a server runs on a child process, once with a single executor
+// (the dispatcher runs every request in order, like before the strands) and once with an executor per core (at least two, so the strands are used at
+// all), while many small channels are busy at once. Every member sends a burst of messages to it's channel and the time until every member received
+// every message of it's channel is measured.
+// Usage: strand-execution-bench [channels] [members per channel] [messages per member]
+
+# include "../src/server/main_server.hpp"
+# include "../src/messaging.hpp"
+
+# include <iostream>
+# include <iomanip>
+# include <string>
+
+# include <vector>
+# include <algorithm>
+
+# include <thread>
+
+# include <chrono>
+
+# include <cstdint>
+# include <cstdlib>
+# include <csignal>
+
+# include <fcntl.h>
+# include <poll.h>
+# include <unistd.h>
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include <arpa/inet.h>
+# include <netinet/in.h>
+
+// How long the server has to start listening and each phase has to finish before the run is given up.
+constexpr int64_t startup_timeout = 5000000000;
+constexpr int64_t phase_timeout = 60000000000;
+
+// Text every benchmark message carries, so they're told apart from the server's replies.
+const std::string message_marker = "bench-message";
+// Reply to a successful /join.
+const std::string join_marker = "you're now on channel";
+
+// Most messages each member can have on it's way before the next round of messages waits for them, so the members' send queues on the server never fill.
+constexpr size_t max_messages_in_flight = 256;
+
+// A member of one of the channels, with what it has received.
+struct bench_member {
+    bench_member() : socket_fd(-1), unacknowledged(0), joined(false), received(0) {}
+    int socket_fd;
+    frame_parser parser;
+    receive_window window;
+    size_t unacknowledged;
+    bool joined;
+    size_t received;
+};
+
+// Results of a run.
+struct bench_result {
+    bool finished;
+    size_t received;
+    double seconds;
+};
+
+// Returns the current time in nanoseconds.
+static int64_t now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+// ==============================================================================================================================================================
+// Server =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Runs the server on a child process (with it's output discarded), returns the child's pid.
+static pid_t start_server(int port, unsigned executor_count) {
+
+    pid_t pid = fork();
+    if(pid != 0)
+        return pid;
+
+    int null_fd = open("/dev/null", O_WRONLY);
+    if(null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        close(null_fd);
+    }
+
+    server srv(port, ib_Epoll, false, default_backlog_length, executor_count);
+    if(srv.get_status() < 0)
+        _exit(1);
+    srv.handle();
+    _exit(0);
+
+}
+
+// Opens a connection to the server, returns -1 if it fails.
+static int connect_to(int port) {
+
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if(socket_fd < 0)
+        return -1;
+
+    struct sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(connect(socket_fd, (struct sockaddr*) &address, sizeof(address)) < 0) {
+        close(socket_fd);
+        return -1;
+    }
+
+    return socket_fd;
+
+}
+
+// Waits until the server is listening, returns false if it never does.
+static bool wait_for_server(int port) {
+
+    int64_t start = now();
+    while(now() - start < startup_timeout) {
+        int socket_fd = connect_to(port);
+        if(socket_fd >= 0) {
+            close(socket_fd);
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return false;
+
+}
+
+// ==============================================================================================================================================================
+// Members ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Takes everything the members have received and acknowledges it, waiting up to timeout milliseconds for something to arrive, returns false if a
+// member is lost.
+static bool receive_ready(std::vector<bench_member> &members, std::vector<struct pollfd> &poll_fds, int timeout) {
+
+    if(poll(poll_fds.data(), poll_fds.size(), timeout) < 0)
+        return false;
+
+    for(size_t i = 0; i < members.size(); i++) {
+
+        if(poll_fds[i].revents == 0)
+            continue;
+
+        bench_member &member = members[i];
+        int status = 0;
+        while(status == 0) {
+            std::string message = check_message(member.socket_fd, member.parser, member.window, &status, &member.unacknowledged);
+            if(status != 0)
+                break;
+            if(message.find(message_marker) != std::string::npos)
+                member.received++;
+            else if(message.find(join_marker) != std::string::npos)
+                member.joined = true;
+        }
+        if(status < 0)
+            return false;
+
+        // Acknowledges everything taken at once, so the server's send window never stalls.
+        if(member.unacknowledged > 0) {
+            send_acknowledgement(member.socket_fd, member.window);
+            member.unacknowledged = 0;
+        }
+
+    }
+
+    return true;
+
+}
+
+// Takes what the members receive until done returns true, returns false if it takes too long or a member is lost.
+template <typename done_check>
+static bool receive_until(std::vector<bench_member> &members, std::vector<struct pollfd> &poll_fds, done_check done) {
+
+    int64_t start = now();
+    while(!done())
+        if(now() - start > phase_timeout || !receive_ready(members, poll_fds, 100))
+            return false;
+
+    return true;
+
+}
+
+// ==============================================================================================================================================================
+// Benchmark ====================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Connects the members and joins them to their channels, then every member sends it's messages and every delivery is waited for.
+static bench_result burst(int port, size_t channel_count, size_t member_count, size_t message_count) {
+
+    bench_result result = { false, 0, 0.0 };
+    std::vector<bench_member> members(channel_count * member_count);
+
+    bool connected = true;
+    for(size_t i = 0; i < members.size(); i++) {
+        members[i].socket_fd = connect_to(port);
+        connected = members[i].socket_fd >= 0;
+        if(!connected)
+            break;
+        send_message(members[i].socket_fd, "/nickname member" + std::to_string(i));
+        send_message(members[i].socket_fd, "/join #bench" + std::to_string(i % channel_count));
+    }
+
+    std::vector<struct pollfd> poll_fds(members.size());
+    for(size_t i = 0; i < members.size() && connected; i++)
+        poll_fds[i] = { members[i].socket_fd, POLLIN, 0 };
+
+    // Every member must be on it's channel before the messages are sent, or some of them would miss messages.
+    connected = connected && receive_until(members, poll_fds, [&]() {
+        return std::all_of(members.begin(), members.end(), [](const bench_member &member) { return member.joined; });
+    });
+
+    // Every member gets every message sent to it's channel, it's own included.
+    size_t expected = member_count * message_count;
+    if(connected) {
+
+        // The messages are sent a round at a time (one from each member), only a few rounds ahead of what the members already received.
+        size_t rounds_ahead = std::max<size_t>(max_messages_in_flight / member_count, 1);
+        int64_t start = now();
+        bool lost = false;
+        for(size_t j = 0; j < message_count && !lost; j++) {
+            if(j >= rounds_ahead) {
+                size_t delivered = (j - rounds_ahead + 1) * member_count;
+                lost = !receive_until(members, poll_fds, [&]() {
+                    return std::all_of(members.begin(), members.end(), [&](const bench_member &member) { return member.received >= delivered; });
+                });
+            }
+            for(size_t i = 0; i < members.size() && !lost; i++)
+                send_message(members[i].socket_fd, "/send " + message_marker + " " + std::to_string(j));
+        }
+
+        result.finished = !lost && receive_until(members, poll_fds, [&]() {
+            return std::all_of(members.begin(), members.end(), [&](const bench_member &member) { return member.received >= expected; });
+        });
+        result.seconds = (now() - start) / 1e9;
+
+    }
+
+    for(auto iter = members.begin(); iter != members.end(); iter++) {
+        result.received += iter->received;
+        if(iter->socket_fd >= 0)
+            close(iter->socket_fd);
+    }
+
+    return result;
+
+}
+
+// Runs the burst against a server with the given amount of executors and prints the results.
+static void run(const char *name, unsigned executor_count, int port, size_t channel_count, size_t member_count, size_t message_count) {
+
+    std::cout << std::setw(8) << name << " (" << executor_count << (executor_count == 1 ? " thread) " : " threads)");
+
+    pid_t pid = start_server(port, executor_count);
+    if(pid < 0 || !wait_for_server(port)) {
+        std::cout << "  server didn't start" << std::endl;
+        if(pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        return;
+    }
+
+    bench_result result = burst(port, channel_count, member_count, message_count);
+
+    kill(pid, SIGINT);
+    waitpid(pid, nullptr, 0);
+
+    if(!result.finished) {
+        std::cout << "  didn't finish, " << result.received << " messages received" << std::endl;
+        return;
+    }
+
+    size_t sent = channel_count * member_count * message_count;
+    std::cout << std::setw(10) << result.seconds * 1000.0 << " ms" << std::setw(12) << sent / result.seconds << " requests/s"
+              << std::setw(12) << result.received / result.seconds << " deliveries/s" << std::endl;
+
+}
+
+int main(int argc, char **argv) {
+
+    size_t channel_count = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 64;
+    size_t member_count = (argc > 2) ? std::strtoul(argv[2], nullptr, 10) : 8;
+    size_t message_count = (argc > 3) ? std::strtoul(argv[3], nullptr, 10) : 50;
+    if(channel_count == 0 || member_count == 0 || message_count == 0) {
+        std::cerr << "Usage: " << argv[0] << " [channels] [members per channel] [messages per member]" << std::endl;
+        return 1;
+    }
+
+    // Lost connections must not kill the benchmark.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    unsigned core_count = std::thread::hardware_concurrency();
+    unsigned parallel_count = std::max(core_count, 2u);
+
+    // Each run gets it's own port, so connections still closing from a run don't get in the way of the next.
+    int base_port = 20000 + getpid() % 20000;
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << channel_count << " channels of " << member_count << " members, " << message_count << " messages per member, " << core_count << " cores"
+              << std::endl;
+
+    run("serial", 1, base_port, channel_count, member_count, message_count);
+    run("strands", parallel_count, base_port + 1, channel_count, member_count, message_count);
+
+    return 0;
+
+}
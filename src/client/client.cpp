@@ -17,9 +17,12 @@
 # include <thread>
 # include <atomic>
 
+# include <chrono>
+
 # include <errno.h>
 
 # include <fcntl.h>
+# include <poll.h>
 # include <csignal>
 
 # include <sys/types.h>
@@ -55,7 +58,10 @@ void ignore_sigint(int signal_num) {
 // ==============================================================================================================================================================
 
 /* Creates a new client and tries connecting to a server. */
-client::client(const char *s_addr, int port_number) { 
+client::client(const char *s_addr, int port_number, float ack_delay) : ack_delay(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(ack_delay))) { 
+
+    // Nothing was received yet.
+    this->unacknowledged_frames = 0;
 
     // Creates a TCP socket.
     this->network_socket = socket(AF_INET, SOCK_STREAM, 0);
@@ -108,7 +114,7 @@ void client::handle() {
     
     // Sends the nickname to the server.
     command_buffer = "/nickname " + command_buffer;
-    send_message(this->network_socket, command_buffer);
+    this->send_command(command_buffer);
     std::cout << std::endl << COLOR_BOLD_YELLOW << "Nickname sent to server... Use /new to check for the server response! If your nickname is invalid you will be given a default nickname that can be changed later!" << COLOR_DEFAULT << std::endl;
 
      // Asks for an initial channel on the server to trie joining.
@@ -119,7 +125,7 @@ void client::handle() {
     
     // Sends the channel name to the server.
     command_buffer = "/join " + command_buffer;
-    send_message(this->network_socket, command_buffer);
+    this->send_command(command_buffer);
     std::cout << std::endl << COLOR_BOLD_YELLOW << "Join channel attempt sent to server... Use /new to check for the server response! If your channel name was invalid you will be need to join a channel later!" << COLOR_DEFAULT << std::endl;
 
     do {
@@ -169,12 +175,8 @@ void client::handle() {
             continue;
         }
 
-        // Checks for the /ack command and ignores it, as it can't be sent directly by the user.
-        if(command_buffer.compare(acknowledge_message) == 0)
-            continue;
-
         // Sends all other messages to the server.
-        send_message(this->network_socket, command_buffer);
+        this->send_command(command_buffer);
 
         // Prints a message saying that the command was sent to server.
         std::cout << std::endl << "Command sent to server... Use /new to check for results!" << std::endl;
@@ -193,7 +195,33 @@ void client::t_listen_to_server() {
 
         // Receives data from the server. A buffer with appropriate size is allocated and must be freed later!
         int status = 0;
-        std::string response_message = check_message(this->network_socket, &status, 1);
+        size_t received_frames = 0;
+        int wait_time = listen_poll_time;
+
+        // Handles receiving and acknowledging in a thread safe way. ------------------------------------------------------------------------------------
+        this->sending.lock(); // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+        // ENTER CRITICAL REGION ============================================================================================================================
+
+        std::string response_message = check_message(this->network_socket, this->parser, this->window, &status, &received_frames);
+
+        // The first message waiting for an acknowledgement starts the delay.
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(received_frames > 0 && this->unacknowledged_frames == 0)
+            this->ack_deadline = now + this->ack_delay;
+        this->unacknowledged_frames += received_frames;
+
+        // Acknowledges the messages received if they waited long enough (or if too many are waiting), unless a command already carried the acknowledgement.
+        if(this->unacknowledged_frames > 0) {
+            if(this->unacknowledged_frames >= max_delayed_acks || now >= this->ack_deadline) {
+                send_acknowledgement(this->network_socket, this->window);
+                this->unacknowledged_frames = 0;
+            } else // Wakes up in time to acknowledge them.
+                wait_time = std::chrono::duration_cast<std::chrono::milliseconds>(this->ack_deadline - now).count() + 1;
+        }
+
+        // EXIT CRITICAL REGION =============================================================================================================================
+        this->sending.unlock(); // Exits the critical region, and opens the semaphore.
+        // --------------------------------------------------------------------------------------------------------------------------------------------------
 
         if(status == 0) {
 
@@ -214,8 +242,12 @@ void client::t_listen_to_server() {
             this->updating_messages.unlock(); // Exits the critical region, and opens the semaphore.
             // --------------------------------------------------------------------------------------------------------------------------------------------------
 
-        } else if (status == 1) { // No new messages.
-            // Do nothing.
+        } else if (status == 1) { // No new messages, sleeps until data arrives or an acknowledgement is due.
+            struct pollfd socket_poll;
+            socket_poll.fd = this->network_socket;
+            socket_poll.events = POLLIN;
+            socket_poll.revents = 0;
+            poll(&socket_poll, 1, wait_time);
         } else { // Server was lost.
             atmc_close_client_flag = true; // Sets the client to close.
         }
@@ -245,3 +277,23 @@ void client::show_new_messages() {
 
 }
 
+// Sends a command to the server, acknowledging the messages received along with it.
+void client::send_command(const std::string &command) {
+
+    // Handles sending in a thread safe way. ------------------------------------------------------------------------------------------------------------
+    this->sending.lock(); // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    // ENTER CRITICAL REGION ============================================================================================================================
+
+    // The command carries the acknowledgement, so the messages waiting for it don't need a frame of their own.
+    if(this->unacknowledged_frames > 0) {
+        send_message(this->network_socket, command, this->window);
+        this->unacknowledged_frames = 0;
+    } else
+        send_message(this->network_socket, command);
+
+    // EXIT CRITICAL REGION =============================================================================================================================
+    this->sending.unlock(); // Exits the critical region, and opens the semaphore.
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+}
+
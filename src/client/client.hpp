@@ -6,6 +6,8 @@
 # ifndef CLIENT_H
 # define CLIENT_H
 
+# include "../messaging.hpp"
+
 # include <string>
 
 # include <queue>
@@ -13,8 +15,18 @@
 # include <mutex>
 # include <atomic>
 
+# include <chrono>
+
 # include <netinet/in.h>
 
+// How long the client waits before acknowledging the messages received, so a single acknowledgement covers many of them or goes along the next command
+// (in seconds, must be bellow the server's minimum retransmission timeout).
+constexpr float default_ack_delay = 0.02;
+// Max amount of messages received that can wait for an acknowledgement, more than that are acknowledged right away.
+constexpr size_t max_delayed_acks = 16;
+// Max time the listening thread sleeps waiting for messages before checking if the client was closed (in milliseconds).
+constexpr int listen_poll_time = 100;
+
 class client
 {
 
@@ -25,7 +37,7 @@ class client
         // ==============================================================================================================================================================
 
         /* Creates a new client and tries connecting to a server. */
-        client(const char *s_addr, int port_number);
+        client(const char *s_addr, int port_number, float ack_delay = default_ack_delay);
 
         /* Closes the socket on the destructor. */
         ~client();
@@ -46,6 +58,9 @@ class client
         // Shows client new messages.
         void show_new_messages();
 
+        // Sends a command to the server, acknowledging the messages received along with it.
+        void send_command(const std::string &command);
+
     private:
 
         // ==============================================================================================================================================================
@@ -56,6 +71,20 @@ class client
         int network_socket;
         struct sockaddr_in server_address;
 
+        /* Keeps the data received from the server until it forms complete messages. (only used by the listening thread) */
+        frame_parser parser;
+
+        /* Which messages were received, how many of them were not acknowledged yet and until when they can wait. (locked by sending) */
+        receive_window window;
+        size_t unacknowledged_frames;
+        std::chrono::steady_clock::time_point ack_deadline;
+
+        /* How long messages received wait to be acknowledged. */
+        const std::chrono::steady_clock::duration ack_delay;
+
+        // Used to lock the socket when sending, so commands and acknowledgements sent by different threads are never mixed.
+        std::mutex sending;
+
         /* Stores the status of the server */
         int client_status;
 
@@ -12,11 +12,13 @@
 # include <iostream>
 # include <string>
 
+# include <cctype>
+
 // Help texts.
 # define HELP_NO_PARAMETERS "\nusage: ./trabalho-redes [parameters]\n\nFor a list of parameters type \"./trabalho-redes --help\"\n"
-# define HELP_FULL "\nusage: ./trabalho-redes PARAMETERS\n\nYou can choose to connect as a client or as a server.\n\n\tTo connect as a client use:\n\t\t./trabalho-redes client\n\n\tTo connect as a server use:\n\t\t./trabalho-redes server (For default port)\n\t\t\tor\n\t\t./trabalho-redes server [port]\n"
-# define HELP_CLIENT "\nusage:\n./trabalho-redes client\n"
-# define HELP_SERVER "\nusage:\n./trabalho-redes server (For default port)\n\tor\n./trabalho-redes server [port]\n"
+# define HELP_FULL "\nusage: ./trabalho-redes PARAMETERS\n\nYou can choose to connect as a client or as a server.\n\n\tTo connect as a client use:\n\t\t./trabalho-redes client [--ack-delay ms]\n\n\tTo connect as a server use:\n\t\t./trabalho-redes server (For default port)\n\t\t\tor\n\t\t./trabalho-redes server [port]\n\n\tServer options (after the port):\n\t\t--io-uring\tUse io_uring for the sockets' I/O instead of epoll\n\t\t--sharded\tEach core accepts and handles it's own connections\n\t\t--backlog\tHow many connections can wait to be accepted\n\t\t--executors\tHow many threads execute requests (1 executes them in order on a single thread)\n\t\t--send-queue\tHow many messages can wait to be sent to each client before it's disconnected\n\n\tClient options:\n\t\t--ack-delay\tHow long messages received wait to be acknowledged (in milliseconds)\n"
+# define HELP_CLIENT "\nusage:\n./trabalho-redes client [--ack-delay ms]\n"
+# define HELP_SERVER "\nusage:\n./trabalho-redes server (For default port)\n\tor\n./trabalho-redes server [port] [--io-uring] [--sharded] [--backlog connections] [--executors threads] [--send-queue messages]\n"
 
 // Default address value.
 constexpr char default_addr[] = "127.0.0.1";
@@ -58,10 +60,21 @@ int main(int argc, char* argv[])
     // Handles the client.
     if(inst_type == it_Client) {
 
+        // Stores how long the messages received wait to be acknowledged.
+        float ack_delay = default_ack_delay;
+
         // Checks for the client parameters.
-        if(argc != 2) { // If unnecessary parameters were provided prints a help message.
-            std::cout << HELP_CLIENT << std::endl;
-            return 0;
+        for(int i = 2; i < argc; i++) {
+
+            std::string argv_i(argv[i]);
+
+            if(argv_i.compare("--ack-delay") == 0 && i + 1 < argc && std::isdigit(argv[i + 1][0])) // Uses the given delay if asked to.
+                ack_delay = std::stof(argv[++i]) / 1000;
+            else { // If invalid parameters were provided prints a help message.
+                std::cout << HELP_CLIENT << std::endl;
+                return 0;
+            }
+
         }
 
         // Store commands received.
@@ -117,7 +130,7 @@ int main(int argc, char* argv[])
         std::cout << std::endl << "Attempting connection to server (" << server_addr << ":" << server_port << ")..." << std::endl;
 
         // Creates the client and attempts to connect to the server.
-        client clnt(server_addr.c_str(), server_port);
+        client clnt(server_addr.c_str(), server_port, ack_delay);
 
         // Checks for errors. 
         int cnct_status = clnt.get_status();
@@ -142,22 +155,51 @@ int main(int argc, char* argv[])
     if(inst_type == it_Server) {
 
         // Stores the port where the server will be hosted.
-        int server_port;
+        int server_port = default_port;
+
+        // Stores the interface used for the sockets' I/O.
+        io_backend backend = ib_Epoll;
+
+        // Stores if each core should accept it's own connections.
+        bool sharded = false;
+
+        // Stores how many connections can wait to be accepted.
+        int backlog = default_backlog_length;
+
+        // Stores how many threads execute requests.
+        unsigned executor_count = default_executor_count;
+
+        // Stores how many messages can wait to be sent to each client.
+        size_t send_queue_capacity = default_send_queue_capacity;
+
+        // Checks for the server parameters.
+        for(int i = 2; i < argc; i++) {
+
+            std::string argv_i(argv[i]);
+
+            if(argv_i.compare("--io-uring") == 0) // Uses io_uring if asked to.
+                backend = ib_Io_uring;
+            else if(argv_i.compare("--sharded") == 0) // Uses sharded mode if asked to.
+                sharded = true;
+            else if(argv_i.compare("--backlog") == 0 && i + 1 < argc && std::isdigit(argv[i + 1][0])) // Uses the given backlog if asked to.
+                backlog = std::stoi(argv[++i]);
+            else if(argv_i.compare("--executors") == 0 && i + 1 < argc && std::isdigit(argv[i + 1][0])) // Uses the given amount of executors if asked to.
+                executor_count = std::stoul(argv[++i]);
+            else if(argv_i.compare("--send-queue") == 0 && i + 1 < argc && std::isdigit(argv[i + 1][0]) && std::stoul(argv[i + 1]) > 0) // Uses the given send queue size if asked to.
+                send_queue_capacity = std::stoul(argv[++i]);
+            else if(i == 2 && !argv_i.empty() && std::isdigit(argv_i[0])) // If a port is provided use it instead.
+                server_port = std::stoi(argv_i);
+            else { // Displays help text if the parameters are invalid.
+                std::cout << HELP_SERVER << std::endl;
+                return 0;
+            }
 
-        // Checks for the client parameters.
-        if(argc == 2) // If no additional parameters were provided use the default ones.
-            server_port = default_port;
-        else if (argc == 3) // If a port is provided use it instead.
-            server_port = std::stoi(std::string(argv[2]));
-        else { // Displays help text if the number of parameters is invalid.
-            std::cout << HELP_SERVER << std::endl;
-            return 0;
         }
         
         std::cout << std::endl << "Creating server at port " << server_port << "..." << std::endl;
 
         // Creates the server on the given port.
-        server srv(server_port);
+        server srv(server_port, backend, sharded, backlog, executor_count, send_queue_capacity);
         
         // Checks for errors. 
         int svr_status = srv.get_status();
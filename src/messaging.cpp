@@ -9,96 +9,319 @@
 # include <errno.h>
 
 # include <fcntl.h>
+# include <poll.h>
 
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/uio.h>
+
+# include <arpa/inet.h>
+
+// ==============================================================================================================================================================
+// Frames =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Writes the header of a frame.
+void write_frame_header(char *header, const frame_header &frame) {
+
+    uint16_t magic = htons(frame_magic);
+    uint32_t numbers[3] = { htonl(frame.length), htonl(frame.sequence), htonl(frame.acknowledgement) };
+
+    memcpy(header, &magic, sizeof(magic));
+    header[2] = frame_version;
+    header[3] = frame.flags;
+    memcpy(header + 4, numbers, sizeof(numbers));
+
+}
+
+// Reads the header of a frame, returns false if the header is invalid.
+bool read_frame_header(const char *header, frame_header &frame) {
+
+    uint16_t magic;
+    uint32_t numbers[3];
+    memcpy(&magic, header, sizeof(magic));
+    memcpy(numbers, header + 4, sizeof(numbers));
+
+    // Checks if the frame belongs to this protocol and to a version that's understood.
+    if(ntohs(magic) != frame_magic || (uint8_t)header[2] != frame_version)
+        return false;
+
+    frame.flags = header[3];
+    frame.length = ntohl(numbers[0]);
+    frame.sequence = ntohl(numbers[1]);
+    frame.acknowledgement = ntohl(numbers[2]);
+
+    // Refuses messages that are too big to be buffered.
+    return frame.length <= max_frame_size;
+
+}
+
+// Returns if a sequence number comes before another (sequence numbers wrap around).
+bool sequence_before(uint32_t first, uint32_t second) { return (int32_t)(first - second) < 0; }
+
+// ==============================================================================================================================================================
+// Receive window ===============================================================================================================================================
+// ==============================================================================================================================================================
+
+receive_window::receive_window() { this->next_expected = 1; }
+
+/* Marks a numbered frame as received, returns false if it was already received before. */
+bool receive_window::receive(uint32_t sequence) {
+
+    // Frames before the next expected were all received already.
+    if(sequence_before(sequence, this->next_expected))
+        return false;
+
+    if(sequence != this->next_expected)
+        return this->received_after.insert(sequence).second;
+
+    // Advances over the frames that had arrived early.
+    this->next_expected++;
+    while(!this->received_after.empty() && *this->received_after.begin() == this->next_expected) {
+        this->received_after.erase(this->received_after.begin());
+        this->next_expected++;
+    }
+
+    return true;
+
+}
+
+/* Returns the number of the next frame expected, every frame before it was received. */
+uint32_t receive_window::get_cumulative() const { return this->next_expected; }
+
+/* Returns the ranges received after the next frame expected, in the format used by acknowledgement frames. */
+std::string receive_window::get_selective() const {
+
+    std::string ranges;
+    size_t range_count = 0;
+
+    for(auto iter = this->received_after.begin(); iter != this->received_after.end() && range_count < max_selective_ranges; range_count++) {
+
+        // Extends the range while the numbers are consecutive.
+        uint32_t start = *iter;
+        uint32_t end = start + 1;
+        for(iter++; iter != this->received_after.end() && *iter == end; iter++)
+            end++;
+
+        uint32_t range[2] = { htonl(start), htonl(end) };
+        ranges.append((const char*)range, sizeof(range));
+
+    }
+
+    return ranges;
+
+}
+
+// ==============================================================================================================================================================
+// Frame parser =================================================================================================================================================
+// ==============================================================================================================================================================
+
+frame_parser::frame_parser() { this->offset = 0; }
+
+/* Adds data received from the connection. */
+void frame_parser::feed(const char *data, size_t size) {
+
+    // Drops the data already parsed before growing the buffer, only when most of the buffer is parsed so the rest is cheap to move.
+    if(this->offset > 0 && this->offset >= this->buffer.size() / 2) {
+        this->buffer.erase(0, this->offset);
+        this->offset = 0;
+    }
+
+    this->buffer.append(data, size);
+
+}
+
+/* Takes the next complete frame, returns 1 if a frame was taken, 0 if the frame is incomplete and -1 if the data is invalid. */
+int frame_parser::next(frame_header &frame, std::string &message) {
+
+    // Waits for the whole header.
+    if(this->buffer.size() - this->offset < frame_header_size)
+        return 0;
+
+    if(!read_frame_header(this->buffer.data() + this->offset, frame))
+        return -1;
+
+    // Waits for the rest of the message, making room for all of it at once.
+    size_t frame_size = frame_header_size + frame.length;
+    if(this->buffer.size() - this->offset < frame_size) {
+        this->buffer.reserve(this->offset + frame_size);
+        return 0;
+    }
+
+    message.assign(this->buffer, this->offset + frame_header_size, frame.length);
+    this->offset += frame_size;
+
+    // Everything was parsed, the buffer can be reused from the start.
+    if(this->offset == this->buffer.size()) {
+        this->buffer.clear();
+        this->offset = 0;
+    }
+
+    return 1;
+
+}
+
+// ==============================================================================================================================================================
+// Sockets ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Waits until a socket is ready for the given events.
+static void wait_socket(int socket, short events) {
+
+    struct pollfd socket_poll;
+    socket_poll.fd = socket;
+    socket_poll.events = events;
+    socket_poll.revents = 0;
+    poll(&socket_poll, 1, -1);
+
+}
+
+// Sends a frame to a socket, the header and the message are sent together without copying them to a new buffer.
+static void send_frame(int socket, const frame_header &frame, const std::string &message) {
+
+    char header[frame_header_size];
+    write_frame_header(header, frame);
+
+    struct iovec parts[2];
+    parts[0].iov_base = header;
+    parts[0].iov_len = frame_header_size;
+    parts[1].iov_base = (void*)message.data();
+    parts[1].iov_len = message.size();
+
+    struct msghdr socket_message;
+    memset(&socket_message, 0, sizeof(socket_message));
+    socket_message.msg_iov = parts;
+    socket_message.msg_iovlen = 2;
+
+    while(socket_message.msg_iovlen > 0) {
+
+        ssize_t sent_now = sendmsg(socket, &socket_message, MSG_NOSIGNAL);
+
+        if(sent_now < 0) {
+            if(errno == EINTR) // Interrupted, tries again.
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK) { // The socket is full, waits until it can be written again.
+                wait_socket(socket, POLLOUT);
+                continue;
+            }
+            return; // Error, the connection will be found lost when receiving.
+        }
+
+        // Skips what was already sent.
+        while(socket_message.msg_iovlen > 0 && (size_t)sent_now >= socket_message.msg_iov->iov_len) {
+            sent_now -= socket_message.msg_iov->iov_len;
+            socket_message.msg_iov++;
+            socket_message.msg_iovlen--;
+        }
+        if(socket_message.msg_iovlen > 0) {
+            socket_message.msg_iov->iov_base = (char*)socket_message.msg_iov->iov_base + sent_now;
+            socket_message.msg_iov->iov_len -= sent_now;
+        }
+
+    }
+
+}
 
 // Sends data to a socket.
 void send_message(int socket, const std::string &message) {
 
-    // Gets the message in the format of an array.
-    const char * c_str = message.c_str();
-    char *message_data = new char[message.size() + 1];
-    for(size_t i = 0; i < message.size() + 1; i++)
-        message_data[i] = c_str[i];
-
-    // Breaks the message into blocks of a maximum size.
-    size_t sent = 0;
-    while (sent < (message.length() + 1)) {
-
-        // Calculates how much data to send in this block.
-        int bytes_to_send;
-        if(message.length() + 1 - sent < max_block_size) {
-            bytes_to_send = message.length() + 1 - sent;
-        } else {
-            bytes_to_send = max_block_size;
-        }
+    // Messages sent this way are not numbered, the connection already delivers them in order.
+    frame_header frame = { 0, (uint32_t)message.size(), 0, 0 };
+    send_frame(socket, frame, message);
+
+}
 
-        // Sends the data.
-        sent += send(socket, message_data + sent, bytes_to_send, 0);
+// Sends data to a socket carrying the acknowledgement of the frames received, so no frame is needed only for the acknowledgement.
+void send_message(int socket, const std::string &message, const receive_window &window) {
 
+    // The selective ranges don't fit along the message, so they still need an acknowledgement of their own.
+    std::string ranges = window.get_selective();
+    if(!ranges.empty()) {
+        send_acknowledgement(socket, window);
+        send_message(socket, message);
+        return;
     }
 
-    delete[] message_data;
+    frame_header frame = { ff_Ack | ff_Piggyback, (uint32_t)message.size(), 0, window.get_cumulative() };
+    send_frame(socket, frame, message);
 
 }
 
-// Tries receiving data from a socket and storing it on a buffer.
-std::string check_message(int socket, int *const status, int need_to_acknowledge) {
+// Sends an acknowledgement of the frames received to a socket.
+void send_acknowledgement(int socket, const receive_window &window) {
+
+    std::string ranges = window.get_selective();
+    frame_header frame = { ff_Ack, (uint32_t)ranges.size(), 0, window.get_cumulative() };
+    send_frame(socket, frame, ranges);
+
+}
+
+// Tries receiving data from a socket, returns the next message received when the status is 0 (1 means no message yet and -1 the connection was lost).
+std::string check_message(int socket, frame_parser &parser, receive_window &window, int *const status, size_t *const received_frames) {
 
     // Stores the received message.
     std::string response_message;
+    frame_header frame;
 
     // Ensures the socket is set to non-blocking.
     int flags = fcntl(socket, F_GETFL);
     flags |= O_NONBLOCK;
     fcntl(socket, F_SETFL, flags);
 
-    // Receives the message.
-    char temp_buffer[max_block_size];
-    int bytes_received = 0;
-    int received_now = 0;
-    do {
+    // Takes frames until one with a new message is found.
+    while(true) {
+
+        // Only receives more data if no complete frame was kept from the last reads.
+        int parsed = parser.next(frame, response_message);
+        while(parsed == 0) {
 
-        // Tries receiving data.        
-        received_now = recv(socket, temp_buffer, max_block_size, 0);
+            // Tries receiving data.
+            char temp_buffer[max_block_size];
+            ssize_t received_now = recv(socket, temp_buffer, max_block_size, 0);
 
-        // Handles no data received.
-        if(received_now == 0) { // The server or client has disconnected in a ordenerly way.
+            // Handles no data received.
+            if(received_now == 0) { // The server or client has disconnected in a ordenerly way.
                 *status = -1;
-                return std::string("\0"); // Returns empty string.
-        } else if (received_now < 0) {
+                return std::string(); // Returns empty string.
+            } else if(received_now < 0) {
 
-            if(errno == EAGAIN || errno == EWOULDBLOCK) { 
-            
-                if(bytes_received == 0) { // No new message.
+                if(errno == EINTR) // Interrupted, tries again.
+                    continue;
+
+                if(errno == EAGAIN || errno == EWOULDBLOCK) // No new message, a partial frame is kept by the parser.
                     *status = 1;
-                    return std::string("\0"); // Returns empty string.
-                } else // Continues waiting for the message.
-                    continue;     
-                
-            } else { // Error.
-                *status = -1;
-                return std::string("\0"); // Returns empty string.
+                else // Error.
+                    *status = -1;
+                return std::string(); // Returns empty string.
+
             }
-            
+
+            parser.feed(temp_buffer, received_now);
+            parsed = parser.next(frame, response_message);
+
         }
 
-        // Adds the received data to the response string and counts the amout of data received.
-        response_message += std::string(temp_buffer);
-        bytes_received += received_now;
+        // The data doesn't follow the protocol.
+        if(parsed < 0) {
+            *status = -1;
+            return std::string(); // Returns empty string.
+        }
+
+        // Messages that are not numbered don't need to be acknowledged.
+        if(!(frame.flags & ff_Data))
+            break;
+
+        // Numbered messages are acknowledged even if they were received before, as the acknowledgement may not have arrived in time.
+        bool is_new = window.receive(frame.sequence);
+        (*received_frames)++;
 
-    } while (received_now < 0 || (received_now == max_block_size && temp_buffer[max_block_size - 1] == '\0'));
-    
+        // Repeated messages and keepalives are discarded.
+        if(is_new && !(frame.flags & ff_Keepalive))
+            break;
 
-    // Sends an acknowledgement that the message has being received if necessary.
-    if(need_to_acknowledge) {
-        // The acknowledge message.
-        std::string ack(acknowledge_message);
-        // Sends the ack
-        send_message(socket, ack);
     }
 
+    *status = 0;
     return response_message;
 
 }
\ No newline at end of file
@@ -6,17 +6,101 @@
 # ifndef MESSAGING_H
 # define MESSAGING_H
 
+# include <set>
 # include <string>
 
+# include <cstdint>
+
 // The maximum number of bytes that can be sent or received at once.
 constexpr size_t max_block_size = 4096;
 
-// The message used to acknowledge data was received.
-constexpr char acknowledge_message[] = "/ack";
+// Every message is sent as a frame, a fixed size header followed by the message itself (all numbers in network byte order):
+// 2 bytes magic number, 1 byte protocol version, 1 byte flags, 4 bytes message length, 4 bytes sequence number, 4 bytes acknowledgement number.
+constexpr uint16_t frame_magic = 0x5243;
+constexpr uint8_t frame_version = 2;
+constexpr size_t frame_header_size = 16;
+// The maximum size of a message inside a frame, bigger frames are treated as a protocol error.
+constexpr uint32_t max_frame_size = 1 << 20;
+
+// Flags of a frame: data frames are numbered and must be acknowledged, acknowledgement frames tell every data frame before their acknowledgement
+// number was received and carry the ranges received after it (selective acknowledgements, pairs of 4 bytes start and 4 bytes end), keepalive frames are
+// empty data frames only sent to check if the other side is still there and piggybacked acknowledgements carry a message instead of the ranges.
+enum frame_flag { ff_Data = 1, ff_Ack = 2, ff_Keepalive = 4, ff_Piggyback = 8 };
+
+// The maximum number of ranges sent on a selective acknowledgement.
+constexpr size_t max_selective_ranges = 4;
+
+// Information carried by the header of a frame.
+struct frame_header {
+    uint8_t flags;
+    uint32_t length;
+    uint32_t sequence;
+    uint32_t acknowledgement;
+};
+
+// Writes the header of a frame.
+void write_frame_header(char *header, const frame_header &frame);
+// Reads the header of a frame, returns false if the header is invalid.
+bool read_frame_header(const char *header, frame_header &frame);
+
+// Returns if a sequence number comes before another (sequence numbers wrap around).
+bool sequence_before(uint32_t first, uint32_t second);
+
+// Keeps which numbered frames were received from a connection, used to discard repeated frames and to acknowledge them.
+class receive_window
+{
+
+    public:
+
+        receive_window();
+
+        /* Marks a numbered frame as received, returns false if it was already received before. */
+        bool receive(uint32_t sequence);
+
+        /* Returns the number of the next frame expected, every frame before it was received. */
+        uint32_t get_cumulative() const;
+
+        /* Returns the ranges received after the next frame expected, in the format used by acknowledgement frames. */
+        std::string get_selective() const;
+
+    private:
+
+        /* Next frame expected and the frames after it that were already received. */
+        uint32_t next_expected;
+        std::set<uint32_t> received_after;
+
+};
+
+// Keeps the data received from a connection and takes the complete frames out of it, a read can carry many frames or only part of one.
+class frame_parser
+{
+
+    public:
+
+        frame_parser();
+
+        /* Adds data received from the connection. */
+        void feed(const char *data, size_t size);
+
+        /* Takes the next complete frame, returns 1 if a frame was taken, 0 if the frame is incomplete and -1 if the data is invalid. */
+        int next(frame_header &frame, std::string &message);
+
+    private:
+
+        /* Data received that was not parsed yet starts at the offset (the buffer is only compacted once in a while). */
+        std::string buffer;
+        size_t offset;
+
+};
 
 // Sends data to a socket.
 void send_message(int socket, const std::string &message);
-// Tries receiving data from a socket and storing it on a buffer.
-std::string check_message(int socket, int *const status, int need_to_acknowledge);
+// Sends data to a socket carrying the acknowledgement of the frames received, so no frame is needed only for the acknowledgement.
+void send_message(int socket, const std::string &message, const receive_window &window);
+// Sends an acknowledgement of the frames received to a socket.
+void send_acknowledgement(int socket, const receive_window &window);
+// Tries receiving data from a socket, returns the next message received when the status is 0 (1 means no message yet and -1 the connection was lost).
+// Every numbered frame received is counted on received_frames, they must be acknowledged by the caller.
+std::string check_message(int socket, frame_parser &parser, receive_window &window, int *const status, size_t *const received_frames);
 
 # endif
\ No newline at end of file
@@ -5,11 +5,13 @@
 
 # include "channel.hpp"
 
+# include "client_table.hpp"
+
 # include <iostream>
 # include <string>
 
-# include <set>
 # include <vector>
+# include <unordered_map>
 
 # include <atomic>
 
@@ -17,8 +19,13 @@
 // Constructors/destructors =====================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Creates a channel with a certain name. */
-channel::channel(std::string name) { this->name = name; }
+/* Creates a channel with a certain id and name. */
+channel::channel(channel_id id, std::string name) {
+
+    this->id = id;
+    this->name = name;
+
+}
 
 // ==============================================================================================================================================================
 // Statics ======================================================================================================================================================
@@ -50,46 +57,49 @@ bool channel::is_valid_channel_name(const std::string &channel_name) {
 // Add/remove ===================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Adds client with socket provided to the members list. */
-bool channel::add_member(int socket) {
+/* Adds client with the handle provided to the members list. */
+bool channel::add_member(client_handle member) {
 
-    /* Adds the new client socket to the server. */
-    if(this->members.find(socket) == this->members.end()) { // Checks if the client is already on this channel.
+    /* Adds the new client handle to the server. */
+    if(this->positions.find(member) == this->positions.end()) { // Checks if the client is already on this channel.
 
-        this->members.insert(socket); // Add to channel members.
+        this->positions[member] = this->members.size(); // Add to channel members.
+        this->members.push_back({ member, false });
 
-        std::cerr << "Client with socket " << socket << " is now on channel " << this-> name << "! ";
+        std::cerr << "Client " << handle_to_string(member) << " is now on channel " << this-> name << "! ";
         std::cerr << "(Channel members: " << std::to_string(this->members.size()) << ")" << std::endl;
         return true;
 
     }
 
-    std::cerr << "Error adding client with socket " << socket << " to channel " << this-> name << ": client is already on the channel! ";
+    std::cerr << "Error adding client " << handle_to_string(member) << " to channel " << this-> name << ": client is already on the channel! ";
     return false; 
 
 }
 
-/* Removes client with socket provided from the members list. */
-bool channel::remove_member(int socket) {
+/* Removes client with the handle provided from the members list. */
+bool channel::remove_member(client_handle member) {
 
     /* Removes the client from the server. */
-    auto iter = this->members.find(socket); // Tries getting an iterator to the client socket to be removed.
-    if(iter != this->members.end()) { // Checks if the client is on the channel.
-
-        this->members.erase(iter); // Remvoes from channel members.
-
-        // Now tries removing from the muted list.
-        iter = this->muted.find(socket); // Tries getting an iterator to the client socket being removed on the muted list.
-        if(iter != this->muted.end()) // Removes the client socket from the muted list if necessary.
-            this->muted.erase(iter);
-
-        std::cerr << "Client with socket " << socket << " left channel " << this-> name << "! ";
+    auto iter = this->positions.find(member); // Tries getting an iterator to the client handle to be removed.
+    if(iter != this->positions.end()) { // Checks if the client is on the channel.
+
+        // Moves the last member to the removed one's place, so the array has no holes (it's muted flag goes with it).
+        size_t position = iter->second;
+        this->positions.erase(iter);
+        if(position + 1 != this->members.size()) {
+            this->members[position] = this->members.back();
+            this->positions[this->members[position].handle] = position;
+        }
+        this->members.pop_back(); // Remvoes from channel members.
+
+        std::cerr << "Client " << handle_to_string(member) << " left channel " << this-> name << "! ";
         std::cerr << "(Channel members: " << std::to_string(this->members.size()) << ")" << std::endl;
         return true;
 
     }
         
-    std::cerr << "Error removing client with socket " << socket << " from channel " << this-> name << ": client is not on the channel! ";
+    std::cerr << "Error removing client " << handle_to_string(member) << " from channel " << this-> name << ": client is not on the channel! ";
     return false;
 
 }
@@ -99,29 +109,30 @@ bool channel::remove_member(int socket) {
 // ==============================================================================================================================================================
 
 /* Mutes and unmutes members of the channel. */
-bool channel::toggle_mute_member(int socket, bool muted) {
+bool channel::toggle_mute_member(client_handle member, bool muted) {
 
-    // Tries getting an iterator to the client socket being muted/unmuted.
-    auto iter = this->muted.find(socket);
+    // Tries getting the position of the member being muted/unmuted.
+    auto iter = this->positions.find(member);
+    if(iter == this->positions.end())
+        return false;
 
-    // Adds the client socket to the muted list if it's not currently there.
-    if(muted && iter == this->muted.end()) {
-        this->muted.insert(socket);
-        return true;
-    } 
-    
-    // Removes the client socket from the muted list if it's currently there.
-    if(!muted && iter != this->muted.end()) { 
-        this->muted.erase(iter);
-        return true;
-    }
+    // Only changes the flag if it's not already set as asked.
+    channel_member &target = this->members[iter->second];
+    if(target.muted == muted)
+        return false;
 
-    return false;
+    target.muted = muted;
+    return true;
 
 }
 
 /* Checks if a certain client is muted on the server. */
-bool channel::is_muted(int socket) const { return (this->muted.find(socket) != this->muted.end()); }
+bool channel::is_muted(client_handle member) const {
+
+    auto iter = this->positions.find(member);
+    return iter != this->positions.end() && this->members[iter->second].muted;
+
+}
 
 /* Checks if the channel has no members. */
 bool channel::is_empty() const { return this->members.empty(); }
@@ -130,13 +141,11 @@ bool channel::is_empty() const { return this->members.empty(); }
 // Getters ======================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Checks if a certain client is the admin of the server. */
-std::string channel::get_name() const { return this->name; }
+/* Returns the channel's id. */
+channel_id channel::get_id() const { return this->id; }
 
-/* Gets an array of this channel's members sockets. */
-std::vector<int> channel::get_members() const {
+/* Returns the channel's name. */
+const std::string &channel::get_name() const { return this->name; }
 
-    // Converts the members set to a vector and returns it.
-    return std::vector<int>(this->members.begin(), this->members.end());
-
-}
+/* Gets this channel's members, stored next to each other so they can be read in sequence without copying them. (invalidated when members are added or removed) */
+const std::vector<channel_member> &channel::get_members() const { return this->members; }
@@ -6,20 +6,36 @@
 # ifndef CHANNEL_H
 # define CHANNEL_H
 
+# include "client_table.hpp"
+
 # include <string>
 
-# include <set>
+# include <cstdint>
+
 # include <vector>
+# include <unordered_map>
 
 # include <atomic>
 
 // Max size of a channel name.
 constexpr size_t max_channel_name_size = 200;
 
+// Identifies a channel inside the server, the name is only used to find it when joining.
+typedef uint32_t channel_id;
+
+// Id that never refers to a channel, used for clients that are on no channel.
+constexpr channel_id no_channel = 0;
+
 // Headers for classes in other files that will be used bellow.
 class server;
 class connected_client;
 
+// A member of a channel and if it's muted on it.
+struct channel_member {
+    client_handle handle;
+    bool muted;
+};
+
 // Struct for a server channel
 class channel
 {
@@ -30,7 +46,7 @@ class channel
         // Constructors/destructors =====================================================================================================================================
         // ==============================================================================================================================================================
         
-        channel(std::string name);
+        channel(channel_id id, std::string name);
 
         // ==============================================================================================================================================================
         // Statics ======================================================================================================================================================
@@ -43,19 +59,19 @@ class channel
         // Add/remove ===================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Adds and removes clients with the provided sockets to/from the members list. */
-        bool add_member(int socket);
-        bool remove_member(int socket);
+        /* Adds and removes clients with the provided handles to/from the members list. */
+        bool add_member(client_handle member);
+        bool remove_member(client_handle member);
 
         // ==============================================================================================================================================================
         // Member operations ============================================================================================================================================
         // ==============================================================================================================================================================
 
         /* Mutes and unmutes members of the channel. */
-        bool toggle_mute_member(int socket, bool muted);
+        bool toggle_mute_member(client_handle member, bool muted);
 
         /* Checks if a certain client is muted on the server. */
-        bool is_muted(int socket) const;
+        bool is_muted(client_handle member) const;
 
         /* Checks if the channel has no members. */
         bool is_empty() const;
@@ -64,11 +80,14 @@ class channel
         // Getters ======================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Checks if a certain client is the admin of the server. */
-        std::string get_name() const;
+        /* Returns the channel's id. */
+        channel_id get_id() const;
+
+        /* Returns the channel's name. */
+        const std::string &get_name() const;
 
-        /* Gets an array of this channel's members sockets. */
-        std::vector<int> get_members() const;
+        /* Gets this channel's members, stored next to each other so they can be read in sequence without copying them. (invalidated when members are added or removed) */
+        const std::vector<channel_member> &get_members() const;
 
     private:
 
@@ -76,14 +95,15 @@ class channel
         // Variables=====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Name used to refer to this channel by clients. */
+        /* Id used to refer to this channel by the server and name used to refer to it by clients. */
+        channel_id id;
         std::string name;
 
-        /* Stores the channel members, stores the sockets of the clients. */
-        std::set<int> members;
+        /* Stores the channel members with their muted flags, the order is not kept so removing a member is done by moving the last one to it's place. */
+        std::vector<channel_member> members;
 
-        /* Stores the muted members. */
-        std::set<int> muted;
+        /* Stores the position of each member on the members array. */
+        std::unordered_map<client_handle, size_t> positions;
 
 };
 
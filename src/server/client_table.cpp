@@ -0,0 +1,74 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "client_table.hpp"
+
+# include <string>
+# include <vector>
+
+# include <cstddef>
+# include <cstdint>
+
+// Returns the handle as text, used on logs.
+std::string handle_to_string(client_handle handle) { return std::to_string((uint32_t)handle) + "." + std::to_string((uint32_t)(handle >> 32)); }
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+client_table::client_table() { }
+
+// ==============================================================================================================================================================
+// Table ========================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Stores a client on a free slot and returns it's handle. */
+client_handle client_table::insert(connected_client *client) {
+
+    // Reuses a freed slot if there's one, keeping it's generation.
+    uint32_t index;
+    if(!this->free_slots.empty()) {
+        index = this->free_slots.back();
+        this->free_slots.pop_back();
+    } else {
+        index = this->slots.size();
+        this->slots.push_back({ nullptr, 1 });
+    }
+
+    this->slots[index].client = client;
+
+    return ((client_handle)this->slots[index].generation << 32) | index;
+
+}
+
+/* Frees the slot of a client, it's handle and every copy of it stop referring to it. */
+void client_table::remove(client_handle handle) {
+
+    if(this->get(handle) == nullptr)
+        return;
+
+    // The next client on this slot gets a new generation (skipping 0, so no handle is ever invalid_client_handle).
+    slot &freed = this->slots[(uint32_t)handle];
+    freed.client = nullptr;
+    if(++freed.generation == 0)
+        freed.generation = 1;
+
+    this->free_slots.push_back((uint32_t)handle);
+
+}
+
+/* Returns the client with a handle, null if the handle is invalid or the client was removed. */
+connected_client *client_table::get(client_handle handle) const {
+
+    uint32_t index = (uint32_t)handle;
+    if(index >= this->slots.size() || this->slots[index].generation != (uint32_t)(handle >> 32))
+        return nullptr;
+
+    return this->slots[index].client;
+
+}
+
+/* Returns the amount of clients stored. */
+size_t client_table::size() const { return this->slots.size() - this->free_slots.size(); }
@@ -0,0 +1,75 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef CLIENT_TABLE_H
+# define CLIENT_TABLE_H
+
+# include <string>
+# include <vector>
+
+# include <cstddef>
+# include <cstdint>
+
+// Identifies a connected client by it's slot on the server's client table (lowest 32 bits) and the generation of that slot (highest 32 bits), so a
+// handle kept after the client disconnects never refers to the next client using the same slot (or the same socket).
+typedef uint64_t client_handle;
+
+// Handle that never refers to a client (generations start at 1).
+constexpr client_handle invalid_client_handle = 0;
+
+// Returns the handle as text, used on logs.
+std::string handle_to_string(client_handle handle);
+
+// Headers for classes in other files that will be used bellow.
+class connected_client;
+
+// Flat table of the connected clients, finding a client by it's handle is a single array access. Freed slots are reused by new clients with the next
+// generation. (not thread-safe, only changed by the server's dispatcher, the tasks it runs only read it)
+class client_table
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        client_table();
+
+        // ==============================================================================================================================================================
+        // Table ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Stores a client on a free slot and returns it's handle. */
+        client_handle insert(connected_client *client);
+
+        /* Frees the slot of a client, it's handle and every copy of it stop referring to it. */
+        void remove(client_handle handle);
+
+        /* Returns the client with a handle, null if the handle is invalid or the client was removed. */
+        connected_client *get(client_handle handle) const;
+
+        /* Returns the amount of clients stored. */
+        size_t size() const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* A position of the table, the generation changes every time it's freed. */
+        struct slot {
+            connected_client *client;
+            uint32_t generation;
+        };
+
+        /* Every slot ever used and the ones that are free to be used again. */
+        std::vector<slot> slots;
+        std::vector<uint32_t> free_slots;
+
+};
+
+# endif
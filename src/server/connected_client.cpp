@@ -6,6 +6,10 @@
 # include "connected_client.hpp"
 
 # include "main_server.hpp"
+# include "reactor.hpp"
+# include "outgoing_message.hpp"
+# include "request_arena.hpp"
+# include "server_reply.hpp"
 # include "../color.hpp"
 # include "../messaging.hpp"
 
@@ -13,19 +17,21 @@
 # include <string>
 
 # include <set>
-# include <queue>
+# include <deque>
+# include <algorithm>
 
-# include <thread>
-# include <mutex>
 # include <atomic>
 
 # include <chrono>
 
-# include <fcntl.h>
-# include <csignal>
+# include <cstring>
+# include <cstdint>
+
+# include <errno.h>
 
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/uio.h>
 
 # include <arpa/inet.h>
 # include <netinet/in.h>
@@ -36,26 +42,31 @@
 // Constructors/destructors =====================================================================================================================================
 // ==============================================================================================================================================================
 
-connected_client::connected_client(int socket, server *const server_instance) : server_instance(server_instance), client_socket(socket) {
+connected_client::connected_client(int socket, server *const server_instance, size_t send_queue_capacity) : server_instance(server_instance), client_socket(socket),
+    send_queue(send_queue_capacity, initial_send_queue_capacity) {
 
     // Initializes the atomics.
     this->atmc_kill = false;
-    this->atmc_ack_received_message = 0;
+    this->atmc_owner = nullptr;
+    this->atmc_send_queue_exceeded = false;
+    this->publish_rtt();
+
+    // The handle is only given when the server registers the client.
+    this->handle = invalid_client_handle;
+
+    // Initially nothing is being sent, messages are numbered from 1.
+    this->next_sequence = 1;
 
     // Initially the nickname comes from the client socket.
     this->nickname = "socket " + std::to_string(socket);
 
     // Initially all clients have no channel.
-    this->current_channel = "NONE";
+    this->current_channel = no_channel;
 
 }
 
 connected_client::~connected_client() {
 
-    // Joins the handler threads.
-    this->listening_handle.join();
-    this->sending_handle.join();
-
     // Closes the socket.
     close(this->client_socket);
 
@@ -88,163 +99,333 @@ bool connected_client::is_valid_nickname(const std::string &nickname) {
 }
 
 // ==============================================================================================================================================================
-// Spawns/threads ===============================================================================================================================================
+// Events =======================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Spawns the thread to handle this client's connection. (Stores it to be joined later) */
-void connected_client::spawn_handle() { 
-    
-    this->listening_handle = std::thread(&connected_client::t_handle_listening, this); 
-    this->sending_handle = std::thread(&connected_client::t_handle_sending, this); 
-    
+/* Called by the reactor when the socket is readable, returns false if the client has disconnected. */
+bool connected_client::handle_input() {
+
+    // Reads everything that's available on the socket.
+    char temp_buffer[max_block_size];
+    while(true) {
+
+        ssize_t received_now = recv(this->client_socket, temp_buffer, max_block_size, 0);
+
+        if(received_now == 0) // The client has disconnected in a ordenerly way.
+            return false;
+
+        if(received_now < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) // Nothing left to read.
+                break;
+            if(errno == EINTR) // Interrupted, tries again.
+                continue;
+            return false; // Error.
+        }
+
+        if(!this->receive(temp_buffer, received_now))
+            return false;
+
+    }
+
+    return true;
+
 }
 
-// ==============================================================================================================================================================
-// Threads ======================================================================================================================================================
-// ==============================================================================================================================================================
+/* Handles data received from the client, by the reactor or by the completion of an asynchronous read, returns false if the client broke the protocol. */
+bool connected_client::receive(const char *data, size_t size) {
+
+    this->parser.feed(data, size);
+
+    // Handles every complete frame received, a partial frame is kept by the parser for the next time.
+    frame_header frame;
+    std::string &message = this->received_message;
+    int parsed;
+    while((parsed = this->parser.next(frame, message)) > 0) {
+        if(frame.flags & ff_Piggyback) { // Acknowledgements carried by a message don't have selective ranges.
+            this->handle_acknowledgement(frame.acknowledgement, std::string());
+            this->handle_message(message);
+        } else if(frame.flags & ff_Ack) // Acknowledgements are handled immediately, so the window moves as soon as possible.
+            this->handle_acknowledgement(frame.acknowledgement, message);
+        else
+            this->handle_message(message);
+    }
 
-/* Thread that handles listening for client connection. */
-void connected_client::t_handle_listening()  {
+    // Gives the server every request from this read at once.
+    if(!this->received_requests.empty()) {
+        this->server_instance->make_requests(this, this->received_requests);
+        this->received_requests.clear();
+    }
 
-    // Runs while the client is not killed.
-    while(!this->atmc_kill) {
+    if(parsed < 0) {
+        std::cerr << COLOR_BOLD_RED << "Client with socket " << std::to_string(this->client_socket) << " sent an invalid frame!" << COLOR_DEFAULT << std::endl;
+        return false;
+    }
 
-        // Checks for data from the client. A buffer with appropriate size is allocated and must be freed later!
-        int status = 0;
-        std::string new_message = check_message(this->client_socket, &status, 0);
+    return true;
 
-        // Checks for the status of the received message.
-        switch(status) { 
+}
 
-            case 0: // A new message with a request was received and must be treated. ============================================
+/* Called by the reactor to send pending data to the client, returns false if the connection failed. */
+bool connected_client::handle_output() {
 
-                // ! Checks for requests that can be handled immediately, some of those are really important to be done as soon as possible like /ack, others
-                // ! like /ping are done this way simple because it's possible and the request is not worth enough to waste the server's time.
-                if(new_message.compare(acknowledge_message) == 0) // Marks that the client has acknowledge a message (done here to avoid delays on the queue).       
-                    this->atmc_ack_received_message--;
-                else if(new_message.compare("/ping") == 0) { // Sends a "pong" back to the client (done here to avoid delays on the queue).       
-                    std::string ping_msg = COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " pong";
-                    this->send(ping_msg);
-                } else // If the request can't be handled here puts it on the request queue.
-                    this->server_instance->make_request(this, new_message);
-                break;
+    if(!this->prepare_output())
+        return false;
+    return this->flush();
 
-            case 1: // No new messages from this client. =========================================================================
-                break; // If there are no messages nothing is done.
+}
 
-            case -1: // The client has disconnected. =============================================================================
-                this->atmc_kill = true; // Kills the connected client. 
-                break;
+/* Starts sending the next queued messages while the send window has room, adding them to the data waiting to be written, returns false if the client must be shut down. */
+bool connected_client::prepare_output() {
+
+    // The client couldn't keep up with the messages sent to it and must be disconnected.
+    if(this->atmc_send_queue_exceeded)
+        return false;
+
+    // Sends messages without waiting for the acknowledgement of the previous ones, as long as the window has room.
+    while(this->send_window.size() < send_window_size) {
+
+        // Takes everything the dispatcher has queued at once when there's nothing left to send.
+        if(this->pending_messages.empty() && this->send_queue.pop_batch(this->pending_messages, this->send_queue.get_capacity()) == 0)
+            break;
+
+        // Numbers the message, marks how many attempts are left for the client to receive and acknowledge it and sends it.
+        this->send_window.emplace_back();
+        unacknowledged_message &sent = this->send_window.back();
+        sent.sequence = this->next_sequence++;
+        sent.flags = ff_Data;
+        sent.message = std::move(this->pending_messages.front());
+        sent.attempts = max_resending_attempts;
+        sent.selectively_acknowledged = false;
+        this->pending_messages.pop_front();
+
+        this->transmit(sent);
 
-            default: // An error has happened. ===================================================================================
-                std::cerr << COLOR_BOLD_RED << "ERROR " << status << "!" << COLOR_DEFAULT << std::endl;
-                break;
-        }        
     }
 
+    return true;
+
 }
 
-/* Thread that handles sending messages to the client. */
-void connected_client::t_handle_sending() {
-    
-    // Runs while the client is not killed.
-    while(!this->atmc_kill) {
-
-        // Stores if there's currently a message to be sent.
-        bool has_message = false;
-
-        // Stores the message being sent.
-        std::string current_message;
-
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-        // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
-        this->updating_message_queue.lock();
-        // ENTER CRITICAL REGION =======================================
-        /* Tries the first message on the queue, modifying the queue can cause problems if the listening handler
-        is also adding a message, thus a semaphore is used. */
-        if(this->message_queue.size() > 0) {
-            current_message = this->message_queue.front(); // Gets the first message on the queue.
-            this->message_queue.pop(); // Removes the message from the queue.
-            has_message = true; // Marks that there's a message to be sent.
+/* Called by the reactor to resend messages that were not acknowledged in time, returns false if the client must be shut down. (the data is written by the reactor) */
+bool connected_client::handle_timeout(const std::chrono::steady_clock::time_point &now) {
+
+    // Only the messages that timed out and that the client didn't acknowledge are sent again.
+    bool timed_out = false;
+    for(auto iter = this->send_window.begin(); iter != this->send_window.end(); iter++) {
+
+        if(iter->selectively_acknowledged || now < iter->deadline)
+            continue;
+
+        // If the client could not confirm the message was received, it must be shut down.
+        if(iter->attempts == 0)
+            return false;
+
+        // Waits twice as long for the messages sent again (once for every timeout, even if many messages timed out together).
+        if(!timed_out) {
+            this->estimator.back_off();
+            this->publish_rtt();
+            timed_out = true;
         }
-        // EXIT CRITICAL REGION ========================================
-        // Exits the critical region, and opens the semaphore.
-        this->updating_message_queue.unlock();
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
 
-        // If there's no request, does nothing and looks agains.
-        if(!has_message)
-            continue; 
+        std::cerr << COLOR_BOLD_YELLOW << "Client with socket " << std::to_string(this->client_socket) << " failed to acknowledge message " << iter->sequence << "! (" << std::to_string(iter->attempts) << " remaining, waiting " << this->get_acknowledge_timeout().count() / 1000 << "ms)" << COLOR_DEFAULT << std::endl;
 
-        // Marks how many attempts are left for a client to receive and acknowledge this message.
-        unsigned attempts = max_resending_attempts;
+        // Attempt to send the message again.
+        this->transmit(*iter);
 
-        // Marks that this clients needs to acknowledges that a message has being received.
-        this->atmc_ack_received_message++;
+    }
 
-        // Used to measure time, when verifying if the message arrived and was acknowledged.
-        std::chrono::time_point<std::chrono::steady_clock> start_time;
-        std::chrono::time_point<std::chrono::steady_clock> current_time;
-        std::chrono::duration<double> diff;
+    return true;
 
-        // Attempt sending the message while there's attempts left and the client is connected.
-        bool success = false;
-        while (!success && attempts > 0 && !this->atmc_kill) {
+}
 
-            // Gets the current time.
-            current_time = std::chrono::steady_clock::now();
-            // Calculates the time difference.
-            diff = current_time - start_time;
+/* Called by the reactor when nothing was received from the client for a while, checks if it's still there with a keepalive frame. */
+void connected_client::send_keepalive() {
 
-            // Checks if it's time to ressend the message or if it's the first attempt..
-            if(diff.count() > acknowledge_wait_time || attempts == max_resending_attempts) {
+    // Messages already waiting for an acknowledgement check the connection by themselves.
+    if(!this->send_window.empty() || !this->pending_messages.empty())
+        return;
 
-                if(attempts < max_resending_attempts) // If the message failed to be sent and this is a retry prints a message.
-                    std::cerr << COLOR_BOLD_YELLOW << "Client with socket " << std::to_string(this->client_socket) << " failed to acknowledge message! (" << std::to_string(attempts) << " remaining)" << COLOR_DEFAULT << std::endl;
+    // The keepalive is numbered like any message, so the client is shut down if it never acknowledges it.
+    this->send_window.emplace_back();
+    unacknowledged_message &sent = this->send_window.back();
+    sent.sequence = this->next_sequence++;
+    sent.flags = ff_Data | ff_Keepalive;
+    sent.attempts = max_resending_attempts;
+    sent.selectively_acknowledged = false;
 
-                // Attempt to send the message.
-                send_message(this->client_socket, current_message);
-                attempts--;
+    this->transmit(sent);
 
-                // Gets the start time for this attempt.
-                start_time = std::chrono::steady_clock::now();
-            }
+}
 
-            // Marks if all messages were successfully sent.
-            if(this->atmc_ack_received_message < 1)
-                success = true;
+/* Returns if there's data that could not be written yet and the socket must be watched for writability. */
+bool connected_client::wants_output() const { return !this->output.empty(); }
 
-        }
+/* Moves the data waiting to be written to a queue that will be written asynchronously, returns false if there's no data. */
+bool connected_client::take_output(output_queue &queue) {
+
+    if(!this->wants_output())
+        return false;
 
-        // If the client could not confirm the message was received, shut it down.
-        if(!success && !this->atmc_kill)
-            shutdown(this->client_socket, SHUT_RDWR);
+    this->output.move_to(queue);
 
+    return true;
+
+}
+
+/* Gets when the first message waiting for an acknowledgement times out, returns false if no message is waiting. */
+bool connected_client::get_ack_deadline(std::chrono::steady_clock::time_point &deadline) const {
+
+    bool waiting = false;
+    for(auto iter = this->send_window.begin(); iter != this->send_window.end(); iter++) {
+        if(!iter->selectively_acknowledged && (!waiting || iter->deadline < deadline)) {
+            deadline = iter->deadline;
+            waiting = true;
+        }
     }
 
+    return waiting;
+
 }
 
 // ==============================================================================================================================================================
 // Messaging ====================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Adds a new message to queue to be sent to this client. */
-void connected_client::send(const std::string &message) {
-
-    // --------------------------------------------------------------------------------------------------------------------------------------------------
-    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
-    this->updating_message_queue.lock();
-    // ENTER CRITICAL REGION =======================================
-    /* Adds the new message to the queue, modifying the queue can cause problems if the send
-    handler is also trying to read it at, thus a semaphore is used. */
-    this->message_queue.push(message); // Copies the new message to the queue.
-    // EXIT CRITICAL REGION ========================================
-    // Exits the critical region, and opens the semaphore.
-    this->updating_message_queue.unlock();
-    // --------------------------------------------------------------------------------------------------------------------------------------------------
-    
+/* Handles a complete message received from the client, the ones that must go to the server are added to the received requests. */
+void connected_client::handle_message(const std::string &message) {
+
+    // ! Checks for requests that can be handled immediately, like /ping, this is done this way simple because it's possible and the request is not
+    // ! worth enough to waste the server's time. (acknowledgements are frames of their own and never get here)
+    if(message.compare("/ping") == 0) { // Sends a "pong" back to the client (done here to avoid delays on the queue).
+        this->reply(get_server_reply(sr_Pong));
+    } else // If the request can't be handled here it's stored on the reactor's arena and given to the server.
+        this->received_requests.push_back(this->get_reactor()->get_request_arena().store(message.data(), message.size()));
+
+}
+
+/* Handles an acknowledgement from the client, releasing every message it has received. */
+void connected_client::handle_acknowledgement(uint32_t cumulative, const std::string &ranges) {
+
+    // Round trips are only measured from messages sent a single time, as it's unknown which attempt was acknowledged otherwise (Karn's rule).
+    bool has_sample = false;
+    std::chrono::steady_clock::time_point sample_sent_time;
+
+    // Every message before the cumulative acknowledgement was received, their buffers are freed if this was the last client using them.
+    while(!this->send_window.empty() && sequence_before(this->send_window.front().sequence, cumulative)) {
+        unacknowledged_message &received = this->send_window.front();
+        if(!received.selectively_acknowledged && received.attempts == max_resending_attempts - 1) {
+            sample_sent_time = received.sent_time;
+            has_sample = true;
+        }
+        this->send_window.pop_front();
+    }
+
+    // Marks the messages received after a missing one, so only the missing ones are sent again. Each range scans the whole send window, so only as many
+    // ranges as a client ever sends are read, the rest of a bigger acknowledgement is ignored.
+    size_t range_count = std::min(ranges.size() / (2 * sizeof(uint32_t)), max_selective_ranges);
+    for(size_t i = 0; i < range_count; i++) {
+
+        uint32_t range[2];
+        memcpy(range, ranges.data() + i * sizeof(range), sizeof(range));
+        uint32_t start = ntohl(range[0]);
+        uint32_t end = ntohl(range[1]);
+
+        for(auto iter = this->send_window.begin(); iter != this->send_window.end(); iter++) {
+            if(!iter->selectively_acknowledged && !sequence_before(iter->sequence, start) && sequence_before(iter->sequence, end)) {
+                if(iter->attempts == max_resending_attempts - 1 && (!has_sample || sample_sent_time < iter->sent_time)) {
+                    sample_sent_time = iter->sent_time;
+                    has_sample = true;
+                }
+                iter->selectively_acknowledged = true;
+                iter->message = outgoing_message();
+            }
+        }
+
+    }
+
+    // Uses the most recent message acknowledged to measure the round trip.
+    if(has_sample) {
+        this->estimator.add_sample(std::chrono::steady_clock::now() - sample_sent_time);
+        this->publish_rtt();
+    }
+
+}
+
+/* Adds a message to the data being written and starts waiting for it's acknowledgement. */
+void connected_client::transmit(unacknowledged_message &sent) {
+
+    // Messages are sent inside numbered frames, the message's parts are written directly from where they're stored.
+    this->output.push(sent.message, sent.sequence, sent.flags);
+    sent.attempts--;
+
+    // Gets the time limit for this attempt from the round trips measured.
+    sent.sent_time = std::chrono::steady_clock::now();
+    sent.deadline = sent.sent_time + this->estimator.get_timeout();
+
+}
+
+/* Updates the copies of the estimator's values used by the diagnostics. */
+void connected_client::publish_rtt() {
+
+    this->atmc_rtt = std::chrono::duration_cast<std::chrono::microseconds>(this->estimator.get_rtt()).count();
+    this->atmc_acknowledge_timeout = std::chrono::duration_cast<std::chrono::microseconds>(this->estimator.get_timeout()).count();
+
+}
+
+/* Writes as much pending data as the socket accepts, returns false if the connection failed. */
+bool connected_client::flush() {
+
+    struct iovec iovecs[max_output_iovecs];
+    struct msghdr socket_message;
+    memset(&socket_message, 0, sizeof(socket_message));
+    socket_message.msg_iov = iovecs;
+
+    while(!this->output.empty()) {
+
+        // Writes as many queued messages as possible with a single system call.
+        socket_message.msg_iovlen = this->output.fill_iovecs(iovecs, max_output_iovecs);
+        ssize_t sent_now = sendmsg(this->client_socket, &socket_message, MSG_NOSIGNAL);
+
+        if(sent_now < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) // The socket is full, the reactor will call again when it's writable.
+                return true;
+            if(errno == EINTR) // Interrupted, tries again.
+                continue;
+            return false; // Error.
+        }
+
+        this->output.consume(sent_now);
+
+    }
+
+    return true;
+
+}
+
+/* Adds a new message to queue to be sent to this client. (the message is sent by the reactor) */
+void connected_client::send(const outgoing_message &message) {
+
+    this->enqueue(message);
+
+    // Tells the reactor that owns the socket there's a new message to be sent.
+    reactor *owner = this->atmc_owner;
+    if(owner != nullptr)
+        owner->notify_output(this);
+
+}
+
+/* Adds a new message to queue without notifying the reactor, used to notify many clients at once. */
+void connected_client::enqueue(const outgoing_message &message) {
+
+    // If the queue is full the client is not reading it's messages fast enough, so it's disconnected instead of making the server hold them.
+    if(!this->send_queue.push(message) && !this->atmc_send_queue_exceeded.exchange(true))
+        std::cerr << COLOR_BOLD_YELLOW << "Client with socket " << std::to_string(this->client_socket) << " exceeded it's send queue! Disconnecting..." << COLOR_DEFAULT << std::endl;
+
 }
 
+/* Adds a new message to be sent to this client from the reactor that owns it, it's written when the reactor handles the client's output. */
+void connected_client::reply(const outgoing_message &message) { this->pending_messages.push_back(message); }
+
 // ==============================================================================================================================================================
 // Getters/setters ==============================================================================================================================================
 // ==============================================================================================================================================================
@@ -255,8 +436,20 @@ int connected_client::get_socket() const {
     return this->client_socket;
 }
 
+/* Sets this client's handle on the server, set by the dispatcher before the client is attached to a reactor. */
+void connected_client::set_handle(client_handle handle) { this->handle = handle; }
+
+/* Returns this client's handle on the server. */
+client_handle connected_client::get_handle() const { return this->handle; }
+
+/* Sets the reactor that owns this client's socket. */
+void connected_client::set_reactor(reactor *owner) { this->atmc_owner = owner; }
+
+/* Returns the reactor that owns this client's socket. */
+reactor *connected_client::get_reactor() const { return this->atmc_owner; }
+
 /* Returns this client's nickname. */
-std::string connected_client::get_nickname() const {
+const std::string &connected_client::get_nickname() const {
     return this->nickname;
 }
 
@@ -267,31 +460,42 @@ bool connected_client::set_nickname(const std::string &nickname) {
     if(!connected_client::is_valid_nickname(nickname))
         return false;
 
-    // Sets the nickname and returns a success.
+    // Sets the nickname and returns a success, the prefix is rendered again with the new nickname.
     this->nickname = nickname;
+    this->message_prefix = message_handle();
     return true;
 
 }
 
 /* Changes the channel this client is connected to. */
-void connected_client::set_channel(const std::string &channel_name, client_role role) {
+void connected_client::set_channel(channel_id channel, client_role role) {
 
-    this->current_channel = channel_name;
+    this->current_channel = channel;
     this->channel_role = role;    
 
+    // The prefix has the channel's name, so it's rendered again for the new channel.
+    this->message_prefix = message_handle();
+
     // Sends a message to the client to enable or disable the admin commands.
-    if(role == cr_Admin) { // Activates showing admin commands.
-        std::string admin_on_msg = "/show_admin_commands";
-        this->send(admin_on_msg);
-    } else {
-        std::string admin_off_msg = "/hide_admin_commands";
-        this->send(admin_off_msg); // Deactivates showing admin commands.
-    }
+    if(role == cr_Admin) // Activates showing admin commands.
+        this->send(get_server_reply(sr_Show_admin_commands));
+    else // Deactivates showing admin commands.
+        this->send(get_server_reply(sr_Hide_admin_commands));
+
+}
+
+/* Returns the prefix of the messages this client sends to it's channel, rendered only when the nickname or the channel changes. (only called by the server's dispatcher) */
+const message_handle &connected_client::get_message_prefix(const std::string &channel_name) {
+
+    if(this->message_prefix.size() == 0)
+        this->message_prefix = message_handle(COLOR_BLUE + channel_name + COLOR_CYAN + " " + this->nickname + ": " + COLOR_DEFAULT);
+
+    return this->message_prefix;
 
 }
 
 /* Returns the channel this client is connected to. */
-std::string connected_client::get_channel() const {
+channel_id connected_client::get_channel() const {
     return this->current_channel;
 }
 
@@ -316,4 +520,10 @@ std::string connected_client::get_ip() const {
     // Returns an empty string.
     return std::string();
 
-}
\ No newline at end of file
+}
+
+/* Returns the last round trip time measured for this client. (thread-safe) */
+std::chrono::microseconds connected_client::get_rtt() const { return std::chrono::microseconds(this->atmc_rtt); }
+
+/* Returns how long the server waits for this client's acknowledgements. (thread-safe) */
+std::chrono::microseconds connected_client::get_acknowledge_timeout() const { return std::chrono::microseconds(this->atmc_acknowledge_timeout); }
\ No newline at end of file
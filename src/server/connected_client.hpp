@@ -7,30 +7,48 @@
 # define CONNECTED_CLIENT_H
 
 # include "connected_client.hpp"
+# include "spsc_ring.hpp"
+# include "outgoing_message.hpp"
+# include "rtt_estimator.hpp"
+# include "client_table.hpp"
+# include "channel.hpp"
+# include "request_arena.hpp"
+# include "../messaging.hpp"
 
 # include <set>
-# include <queue>
+# include <string>
+# include <deque>
+# include <vector>
 
-# include <thread>
-# include <mutex>
 # include <atomic>
 
+# include <chrono>
+
+# include <cstdint>
+
 # include <netinet/in.h>
 
 // Max size of a connect client's nickname.
 constexpr size_t max_nickname_size = 50;
-// Amount of times the server will try resending a message to a connected client.
+// Amount of times the server will try resending a message to a connected client (the time waited doubles on each attempt).
 constexpr unsigned max_resending_attempts = 5;
-// Amount of time the server will wait before an attempt to send a message to a connected client fails (in seconds).
-constexpr float acknowledge_wait_time = 0.400;
+// Max amount of messages waiting to be sent to a connected client when none is given with --send-queue, if it can't keep up with them it's disconnected.
+constexpr size_t default_send_queue_capacity = 1024;
+// Amount of messages the send queue holds before it first grows, so idle clients (like most members of a large channel) keep it small.
+constexpr size_t initial_send_queue_capacity = 8;
+// Max amount of messages sent to a connected client that can be waiting for an acknowledgement at the same time.
+constexpr size_t send_window_size = 64;
+// Time without receiving anything from a connected client before the server checks if it's still there (in seconds).
+constexpr float client_idle_time = 30.0;
 
 // Possible role for the connected client.
 enum client_role { cr_No_channel, cr_Normal, cr_Admin };
 
 // Headers for classes in other files that will be used bellow.
 class server;
+class reactor;
 
-// Struct for the connection, so that we can pass it as an argument to the handle_client threads
+// Struct for the connection, it's socket is handled by one of the server's reactors.
 class connected_client
 {
 
@@ -40,19 +58,16 @@ class connected_client
         // Constructors/destructors =====================================================================================================================================
         // ==============================================================================================================================================================
 
-        connected_client(const int socket, server *const server_instance);
+        connected_client(const int socket, server *const server_instance, size_t send_queue_capacity = default_send_queue_capacity);
         ~connected_client();
 
         // ==============================================================================================================================================================
         // Atomics ======================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* If this conenction should be killed, used when disconnecting from server. */
+        /* If this conenction should be killed, set by the reactor after it stops watching the client's socket. */
         std::atomic_bool atmc_kill;
 
-        /* Stores the value to check if messages where received and acknowledged. */
-        std::atomic_int32_t atmc_ack_received_message;
-
         // ==============================================================================================================================================================
         // Statics ======================================================================================================================================================
         // ==============================================================================================================================================================
@@ -61,18 +76,48 @@ class connected_client
         static bool is_valid_nickname(const std::string &nickname);
 
         // ==============================================================================================================================================================
-        // Spawns =======================================================================================================================================================
+        // Events =======================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Spawns the thread to handle this client's connection. */
-        void spawn_handle();
+        /* Called by the reactor when the socket is readable, returns false if the client has disconnected. */
+        bool handle_input();
+
+        /* Handles data received from the client, by the reactor or by the completion of an asynchronous read, returns false if the client broke the protocol. */
+        bool receive(const char *data, size_t size);
+
+        /* Called by the reactor to send pending data to the client, returns false if the connection failed. */
+        bool handle_output();
+
+        /* Starts sending the next queued messages while the send window has room, adding them to the data waiting to be written, returns false if the client must be shut down. */
+        bool prepare_output();
+
+        /* Called by the reactor to resend messages that were not acknowledged in time, returns false if the client must be shut down. (the data is written by the reactor) */
+        bool handle_timeout(const std::chrono::steady_clock::time_point &now);
+
+        /* Called by the reactor when nothing was received from the client for a while, checks if it's still there with a keepalive frame. */
+        void send_keepalive();
+
+        /* Returns if there's data that could not be written yet and the socket must be watched for writability. */
+        bool wants_output() const;
+
+        /* Moves the data waiting to be written to a queue that will be written asynchronously, returns false if there's no data. */
+        bool take_output(output_queue &queue);
+
+        /* Gets when the first message waiting for an acknowledgement times out, returns false if no message is waiting. */
+        bool get_ack_deadline(std::chrono::steady_clock::time_point &deadline) const;
 
         // ==============================================================================================================================================================
         // Messaging ====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Adds a new message to queue to be sent to this client. */
-        void send(const std::string &message);
+        /* Adds a new message to queue to be sent to this client. (only called by the server's dispatcher or the task running this client's channel) */
+        void send(const outgoing_message &message);
+
+        /* Adds a new message to queue without notifying the reactor, used to notify many clients at once. (only called by the server's dispatcher or the task running this client's channel) */
+        void enqueue(const outgoing_message &message);
+
+        /* Adds a new message to be sent to this client from the reactor that owns it, it's written when the reactor handles the client's output. */
+        void reply(const outgoing_message &message);
 
         // ==============================================================================================================================================================
         // Getters/setters ==============================================================================================================================================
@@ -81,17 +126,28 @@ class connected_client
         /* Returns this client's nickname. */
         int get_socket() const;
 
+        /* Sets and returns this client's handle on the server, set by the dispatcher before the client is attached to a reactor. */
+        void set_handle(client_handle handle);
+        client_handle get_handle() const;
+
+        /* Sets and returns the reactor that owns this client's socket. */
+        void set_reactor(reactor *owner);
+        reactor *get_reactor() const;
+
         /* Returns this client's nickname. */
-        std::string get_nickname() const;
+        const std::string &get_nickname() const;
 
         /* Tries updating the player nickname. */
         bool set_nickname(const std::string &nickname);
 
         /* Changes the channel this client is connected to. */
-        void set_channel(const std::string &channel_name, client_role role);
+        void set_channel(channel_id channel, client_role role);
 
         /* Returns the channel this client is connected to. */
-        std::string get_channel() const;
+        channel_id get_channel() const;
+
+        /* Returns the prefix of the messages this client sends to it's channel, rendered only when the nickname or the channel changes. (only called by the server's dispatcher or the task running this client's channel) */
+        const message_handle &get_message_prefix(const std::string &channel_name);
 
         /* Returns the role of this client on it's channel. */
         client_role get_role() const;
@@ -99,6 +155,10 @@ class connected_client
         /* Returns the ip of this client as a string. */
         std::string get_ip() const;
 
+        /* Returns the last round trip time measured for this client and how long the server waits for it's acknowledgements. (thread-safe) */
+        std::chrono::microseconds get_rtt() const;
+        std::chrono::microseconds get_acknowledge_timeout() const;
+
     private:
 
         // ==============================================================================================================================================================
@@ -111,32 +171,78 @@ class connected_client
         /* This client's socket. */
         const int client_socket;
 
-        // Used to store messages that need to be send to this client.
-        std::queue<std::string> message_queue;
-        // Used to lock the message queue when reading or writing to it.
-        std::mutex updating_message_queue;
+        /* Identifies this client on the server, it's never reused after the client disconnects. */
+        client_handle handle;
+
+        /* The reactor that owns this client's socket. */
+        std::atomic<reactor*> atmc_owner;
+
+        // Used to store messages that need to be send to this client, filled by the server's dispatcher (or the task running the client's channel) and emptied by the reactor.
+        spsc_ring<outgoing_message> send_queue;
+        // If the send queue was full when adding a message, the client can't keep up and must be disconnected.
+        std::atomic_bool atmc_send_queue_exceeded;
+
+        /* Messages taken from the send queue or added by the reactor itself that were not sent yet. (only used by the reactor) */
+        std::deque<outgoing_message> pending_messages;
+
+        /* Data received that doesn't form a complete message yet and the requests taken from the last read. (only used by the reactor) */
+        frame_parser parser;
+        std::vector<request_payload> received_requests;
+        /* Last message taken from the parser, kept so it's memory is reused by the next one. (only used by the reactor) */
+        std::string received_message;
+
+        /* Messages waiting to be written to the socket. (only used by the reactor) */
+        output_queue output;
+
+        /* A message sent that is waiting to be acknowledged, how many times it can still be sent and when the current attempt times out. */
+        struct unacknowledged_message {
+            uint32_t sequence;
+            uint8_t flags;
+            outgoing_message message;
+            unsigned attempts;
+            bool selectively_acknowledged;
+            std::chrono::steady_clock::time_point sent_time;
+            std::chrono::steady_clock::time_point deadline;
+        };
+
+        /* Messages sent that were not acknowledged yet (the send window) and the number of the next message sent. (only used by the reactor) */
+        std::deque<unacknowledged_message> send_window;
+        uint32_t next_sequence;
+
+        /* Measures the round trips to this client to know how long to wait for acknowledgements. (only used by the reactor) */
+        rtt_estimator estimator;
+        /* Copies of the estimator's round trip time and timeout (in microseconds), read by the server's diagnostics. */
+        std::atomic<int64_t> atmc_rtt;
+        std::atomic<int64_t> atmc_acknowledge_timeout;
 
         /* Nickname for this connected client. */
         std::string nickname;
 
         /* Current channel for this client and his respective role. */
-        std::string current_channel;
+        channel_id current_channel;
         client_role channel_role;
 
-        /* Stores the thread that handles listening for this clients conenction. */
-        std::thread listening_handle;
-        /* Stores the thread that handles seninding messages to this client. */
-        std::thread sending_handle;
+        /* Prefix of the messages this client sends to it's channel, empty until rendered. (only used by the server's dispatcher or the task running this client's channel) */
+        message_handle message_prefix;
 
         // ==============================================================================================================================================================
-        // Threads ======================================================================================================================================================
+        // Messaging ====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Thread that handles listening for client connection. */
-        void t_handle_listening();
+        /* Handles a complete message received from the client, the ones that must go to the server are added to the received requests. */
+        void handle_message(const std::string &message);
+
+        /* Handles an acknowledgement from the client, releasing every message it has received. */
+        void handle_acknowledgement(uint32_t cumulative, const std::string &ranges);
+
+        /* Adds a message to the data being written and starts waiting for it's acknowledgement. */
+        void transmit(unacknowledged_message &sent);
+
+        /* Updates the copies of the estimator's values used by the diagnostics. */
+        void publish_rtt();
 
-        /* Thread that handles sending messages to the client. */
-        void t_handle_sending();
+        /* Writes as much pending data as the socket accepts, returns false if the connection failed. */
+        bool flush();
 
 };
 
@@ -10,25 +10,43 @@
 # include "channel.hpp"
 # include "request.hpp"
 # include "connected_client.hpp"
+# include "reactor.hpp"
+# include "uring.hpp"
+# include "outgoing_message.hpp"
+# include "message_buffer.hpp"
+# include "client_table.hpp"
+# include "server_reply.hpp"
+# include "request_arena.hpp"
+# include "work_stealing_pool.hpp"
 # include "../messaging.hpp"
 
 # include <iostream>
 # include <string>
 
 # include <map>
+# include <unordered_map>
+# include <vector>
+# include <functional>
 # include <queue>
+# include <algorithm>
 
 # include <thread>
 # include <mutex>
 # include <atomic>
 
 # include <errno.h>
+# include <cstring>
 
 # include <fcntl.h>
 # include <csignal>
 
+# include <chrono>
+
+# include <poll.h>
+
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/eventfd.h>
 
 # include <arpa/inet.h>
 # include <netinet/in.h>
@@ -42,35 +60,108 @@
 // Used to indicate when the server should be closed.
 std::atomic_bool atmc_close_server_flag(false);
 
+// Used to indicate the server should print it's diagnostics.
+std::atomic_bool atmc_print_diagnostics_flag(false);
+
+// Event the dispatcher sleeps on, so the signals can wake it up.
+int dispatcher_signal_fd = -1;
+
 // ==============================================================================================================================================================
 // Signals ======================================================================================================================================================
 // ==============================================================================================================================================================
 
+// Wakes the dispatcher up from a signal handler.
+void signal_dispatcher() {
+
+    uint64_t value = 1;
+    if(dispatcher_signal_fd >= 0 && write(dispatcher_signal_fd, &value, sizeof(value)) < 0) {
+        // The counter is already full, so the dispatcher will wake up anyways.
+    }
+
+}
+
 // Sets the flag to indicate the server should be closed.
-void close_server(int signal_num) { atmc_close_server_flag = true; }
+void close_server(int signal_num) { atmc_close_server_flag = true; signal_dispatcher(); }
+
+// Sets the flag to indicate the server should print it's diagnostics.
+void request_diagnostics(int signal_num) { atmc_print_diagnostics_flag = true; signal_dispatcher(); }
 
 // ==============================================================================================================================================================
 // Constructors/destructors =====================================================================================================================================
 // ==============================================================================================================================================================
 
 // Creates a new server with a network socket and binds the socket.
-server::server(int port_number) { 
-
-    // Creates a TCP socket.
-    this->server_socket = socket(AF_INET, SOCK_STREAM, 0);
-
-    // Sets the socket to be non-blocking.
-    int flags = fcntl(this->server_socket, F_GETFL);
-    flags |= O_NONBLOCK;
-    fcntl(this->server_socket, F_SETFL, flags);
+server::server(int port_number, io_backend backend, bool sharded, int backlog, unsigned executor_count, size_t send_queue_capacity) : request_queue(request_queue_capacity) { 
+
+    this->backend = backend;
+    this->sharded = sharded;
+    this->backlog = backlog;
+    this->send_queue_capacity = send_queue_capacity;
+
+    // Creates the event the dispatcher sleeps on.
+    this->dispatcher_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->atmc_dispatcher_sleeping = false;
+    this->atmc_wakeup_requested = 0;
+    this->wakeup_count = 0;
+    this->total_wakeup_latency = 0;
+    this->max_wakeup_latency = 0;
+    this->atmc_accepted_count = 0;
+    this->executed_count = 0;
+    this->rate_window_start = std::chrono::steady_clock::now();
+    this->rate_window_count = 0;
+    this->rate_window_last = this->rate_window_start;
+    this->peak_request_rate = 0;
+    this->attach_batch_count = 0;
+    this->parallel_group_count = 0;
+    this->parallel_strand_count = 0;
+    this->atmc_large_fanout_count = 0;
+    this->atmc_total_fanout_time = 0;
+    this->atmc_max_fanout_time = 0;
+
+    // Checks if io_uring is available, using epoll otherwise.
+    if(this->backend == ib_Io_uring) {
+        uring test_ring(1);
+        if(test_ring.get_status() < 0) {
+            std::cerr << COLOR_BOLD_YELLOW << "io_uring is not available, using epoll instead!" << COLOR_DEFAULT << std::endl;
+            this->backend = ib_Epoll;
+        }
+    }
 
     // Gets an address for the socket.
     this->server_address.sin_family = AF_INET;
     this->server_address.sin_port = htons(port_number);
     this->server_address.sin_addr.s_addr = INADDR_ANY;
+    this->server_status = 0;
 
-    // Binds the server to the socket.
-    this->server_status = bind(this->server_socket, (struct sockaddr *) &(this->server_address), sizeof(this->server_address));
+    // Creates the socket that accepts every connection, on sharded mode each reactor creates it's own instead.
+    this->server_socket = -1;
+    if(!this->sharded)
+        this->server_socket = this->open_listener(false);
+
+    // Creates a reactor for each core to handle the clients' I/O.
+    unsigned reactor_count = std::thread::hardware_concurrency();
+    if(reactor_count == 0)
+        reactor_count = 1;
+    for(unsigned i = 0; i < reactor_count; i++) {
+
+        // On sharded mode all the reactors' sockets share the same port and the kernel balances the connections between them.
+        int listener = -1;
+        if(this->sharded)
+            listener = this->open_listener(true);
+
+        reactor *new_reactor = new reactor(this, this->backend, listener);
+        if(new_reactor->get_status() < 0 && this->server_status >= 0)
+            this->server_status = new_reactor->get_status();
+        this->reactors.push_back(new_reactor);
+
+    }
+    this->next_reactor = 0;
+
+    // Creates the threads that execute requests with the dispatcher, the dispatcher itself is one of them (with a single one every request is
+    // executed by the dispatcher in order).
+    if(executor_count == 0)
+        executor_count = std::thread::hardware_concurrency();
+    this->executor = new work_stealing_pool(executor_count > 1 ? executor_count - 1 : 0);
 
 }
 
@@ -84,7 +175,7 @@ server::~server() {
     // Deletes new client from the new client queue.
     while (!this->new_clients.empty()) {
         // Gets a new client from the queue.
-        connected_client *new_client = this->new_clients.front();
+        connected_client *new_client = this->new_clients.front().first;
         delete new_client; // Deletes the client.
         this->new_clients.pop(); // Removes from the queue.
     } 
@@ -93,6 +184,13 @@ server::~server() {
     this->updating_new_clients.unlock();
     // --------------------------------------------------------------------------------------------------------------------------------------------------
 
+    // Stops the reactors so no one else is using the clients.
+    for(auto iter = this->reactors.begin(); iter != this->reactors.end(); iter++)
+        delete *iter;
+
+    // Stops the threads executing requests.
+    delete this->executor;
+
     // Shutdowns and kills any remaining clients.
     for(auto iter = this->clients.begin(); iter != this->clients.end(); iter++) {
         shutdown((*iter)->get_socket(), SHUT_RDWR);
@@ -105,8 +203,19 @@ server::~server() {
     // Calls check_channels to get rid of the channels.
     this->check_channels();
 
+    // Deletes any channel left.
+    for(auto iter = this->channels.begin(); iter != this->channels.end(); iter++)
+        if(*iter != nullptr)
+            delete *iter;
+
     // Closes the socket.
-    close(this->server_socket);
+    if(this->server_socket >= 0)
+        close(this->server_socket);
+
+    // Closes the dispatcher's event.
+    dispatcher_signal_fd = -1;
+    if(this->dispatcher_fd >= 0)
+        close(this->dispatcher_fd);
 
 }
 
@@ -115,172 +224,293 @@ server::~server() {
 // ==============================================================================================================================================================
 
 /* Returns the status of the server */
-int server::get_status() { return this->server_status; }
+int server::get_status() { return this->server_status < 0 ? this->server_status : (this->dispatcher_fd < 0 ? -1 : 0); }
 
 
 // Handles the server instance (control of the program is given to the server until it finishes).
 void server::handle() {
 
-    // Sets the server to be closed when CTRL+C is pressed.
+    // Sets the server to be closed when CTRL+C is pressed and to print it's diagnostics on SIGUSR1.
+    dispatcher_signal_fd = this->dispatcher_fd;
     std::signal(SIGINT, close_server);
+    std::signal(SIGUSR1, request_diagnostics);
 
-    // Spawns the thread that handles client connections.
-    std::thread connections_handler(&server::t_handle_connections, this);
+    // Spawns the threads that handle the clients' I/O.
+    for(auto iter = this->reactors.begin(); iter != this->reactors.end(); iter++)
+        (*iter)->spawn_handle();
 
-    // Executes until the server is closed, processing client requests.
-    while(!atmc_close_server_flag) {
+    // Spawns the thread that handles client connections, on sharded mode the reactors accept the connections themselves.
+    std::thread connections_handler;
+    if(!this->sharded)
+        connections_handler = std::thread(&server::t_handle_connections, this);
 
-        // Checks for any changes in the client connections before processing a new request.
-        server::check_connections();
+    // Requests taken from the queue at once.
+    std::vector<request> batch;
+    batch.reserve(max_request_batch);
 
-        // Checks for any empty channels that should be removed before processing a new request.
-        server::check_channels();
+    // Executes until the server is closed, processing client requests.
+    while(!atmc_close_server_flag) {
 
-        // Stores if there's currently a request to be processed.
-        bool has_request = false;
+        // Takes every request that's ready (up to a limit) without locking the queue.
+        batch.clear();
+        if(this->request_queue.pop_batch(batch, max_request_batch) == 0) {
 
-        // Stores the request being processed.
-        request current_request;
+            // Handles the connections and channels and sleeps until there's something to do.
+            this->check_connections();
+            this->check_channels();
+            this->wait_for_work();
+            continue;
 
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-        // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
-        this->updating_request_queue.lock();
-        // ENTER CRITICAL REGION =======================================
-        /* Tries the first request on the queue, modifying the queue can cause problems if some client
-        handler is also adding a request, thus a semaphore is used. */
-        if(this->request_queue.size() > 0) {
-            current_request = this->request_queue.front(); // Gets the first request on the queue.
-            this->request_queue.pop(); // Removes the request from the queue.
-            has_request = true; // Marks that there's a request.
         }
-        // EXIT CRITICAL REGION ========================================
-        // Exits the critical region, and opens the semaphore.
-        this->updating_request_queue.unlock();
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-
-        // If there's no request, does nothing and looks agains.
-        if(!has_request)
-            continue;        
-
-        // Gets the client that sent this request.
-        connected_client *origin = this->get_client_ref(current_request.get_origin_socket());
-        if(origin == nullptr) { // Checks if the client who sent the request is still avaliable.
-            std::cerr << COLOR_YELLOW << "Request cancelled! (Client with socket " << current_request.get_origin_socket() << COLOR_YELLOW << " is no longer avaliable)";
-            continue;
+
+        // Checks for any changes in the client connections and for any empty channels that should be removed once before processing the whole batch
+        // (requests from clients removed in the meantime are cancelled and channels that got members again are kept).
+        this->check_connections();
+        this->check_channels();
+
+        this->execute_batch(batch);
+        this->count_requests(batch.size());
+
+        // Releases the requests executed from their arenas at once, requests received together are stored on the same block.
+        for(auto iter = batch.begin(); iter != batch.end();) {
+            arena_block *block = iter->get_block();
+            unsigned count = 0;
+            for(; iter != batch.end() && iter->get_block() == block; iter++)
+                count++;
+            request_arena::release(block, count);
         }
 
-        // Gets the data from the request.
-        std::string data =  current_request.get_data();
+    }
 
-        // Stores if the request failed because the client doesn't have needed admin rights.
-        // Used to send a warning to the client later.
-        bool admin_failed = false;
+    // Waits for the threads to finish before giving control back to the main program.
+    if(connections_handler.joinable())
+        connections_handler.join();
 
-        // ! NOTE: /ack and /ping request are handled immediately and are not put on the request queue to avoid delays.
-        // Checks for the type of the request and executes it properly.
-        switch (current_request.get_type()) {
+    // Prints the final diagnostics.
+    this->print_diagnostics();
 
-            case rt_Send:
-                this->send_request(origin, data);
-                break;
+}
 
-            case rt_Nickname:
-                this->nickname_request(origin, data);
-                break;
+// ==============================================================================================================================================================
+// Client handling ==============================================================================================================================================
+// ==============================================================================================================================================================
 
-            case rt_Join:
-                this->join_request(origin, data);
-                break;
+/* Separate thread to handle the connection of new clients */
+void server::t_handle_connections() {
 
-            case rt_Admin_kick:
-                if(origin->get_role() == cr_Admin)
-                    this->kick_request(origin, data);
-                else admin_failed = true;
-                break;
+    // Uses io_uring to accept the connections if asked to.
+    if(this->backend == ib_Io_uring) {
+        this->handle_connections_uring();
+        return;
+    }
 
-            case rt_Admin_mute:
-                if(origin->get_role() == cr_Admin)
-                    this->toggle_mute_request(origin, data, true);
-                else admin_failed = true;
-                break;
+    // Sockets accepted at once.
+    std::vector<int> accepted;
+    accepted.reserve(max_accept_batch);
 
-            case rt_Admin_unmute:
-                if(origin->get_role() == cr_Admin)
-                    this->toggle_mute_request(origin, data, false);
-                else admin_failed = true;
-                break;
+    // Executes until the server is closed.
+    while(!atmc_close_server_flag) {
 
-            case rt_Admin_whois:
-                if(origin->get_role() == cr_Admin)
-                    this->whois_request(origin, data);
-                else admin_failed = true;
-                break;
-            
-            default:
-                break;
+        // Sleeps until connections are waiting, checking once in a while if the server was closed.
+        struct pollfd listener_poll;
+        listener_poll.fd = this->server_socket;
+        listener_poll.events = POLLIN;
+        listener_poll.revents = 0;
+        if(poll(&listener_poll, 1, accept_wait_time) <= 0)
+            continue;
+
+        // Accepts every connection waiting and hands them to the dispatcher together.
+        bool more = true;
+        while(more) {
+            accepted.clear();
+            more = server::accept_pending(this->server_socket, accepted);
+            if(!accepted.empty())
+                this->accept_clients(accepted, nullptr);
         }
 
-        if(admin_failed) // Sends a warning to the client that a request failed because it's not an admin.
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " you must be an admin to do that!");
-        
     }
 
-    // Waits for the threads to finish before giving control back to the main program.
-    connections_handler.join();
-
 }
 
-// ==============================================================================================================================================================
-// Client handling ==============================================================================================================================================
-// ==============================================================================================================================================================
+/* Accepts new clients keeping a batch of accepts submitted to io_uring. */
+void server::handle_connections_uring() {
 
-/* Separate thread to handle the connection of new clients */
-void server::t_handle_connections() {
+    uring ring(uring_accept_batch);
+    if(ring.get_status() < 0) {
+        std::cerr << COLOR_BOLD_RED << "Error creating the io_uring instance to accept connections!" << COLOR_DEFAULT << std::endl;
+        return;
+    }
+
+    // Amount of accepts submitted that didn't complete yet.
+    unsigned submitted_accepts = 0;
+
+    // Sockets accepted by the completions of each wake up.
+    std::vector<int> accepted;
+    accepted.reserve(uring_accept_batch);
 
     // Executes until the server is closed.
     while(!atmc_close_server_flag) {
 
-        // Listens for a new connection.
-        listen(this->server_socket, backlog_length);
+        // Keeps the batch of accepts submitted, the ones that don't fit on the ring are submitted on the next iterations.
+        while(submitted_accepts < uring_accept_batch) {
+            struct io_uring_sqe *sqe = ring.get_sqe();
+            if(sqe == nullptr)
+                break;
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = this->server_socket;
+            sqe->accept_flags = SOCK_CLOEXEC;
+            submitted_accepts++;
+        }
+
+        // Submits the new accepts and waits for new connections.
+        ring.submit_and_wait(1, accept_wait_time);
 
-        // Accepts the connection and returns the client socket.
-        int new_client_socket = accept(this->server_socket, nullptr, nullptr);
+        accepted.clear();
+        struct io_uring_cqe cqe;
+        while(ring.pop_cqe(cqe)) {
 
-        // If no connection happened, checks why.
-        if(new_client_socket == -1) {
+            submitted_accepts--;
 
-            // No connection is avaliable, nothing to do here.
-            if(errno == EAGAIN || errno == EWOULDBLOCK)
-                continue;
+            // Each completion's result is the accepted socket.
+            if(cqe.res >= 0)
+                accepted.push_back(cqe.res);
+            else if(cqe.res != -EAGAIN && cqe.res != -EINTR)
+                std::cerr << COLOR_RED << "Unidentified connection error!" << COLOR_DEFAULT << std::endl;
 
-            // Other types of errors.
-            std::cerr << COLOR_RED << "Unidentified connection error!" << COLOR_DEFAULT << std::endl;
-            continue;
-            
         }
 
-        // Creates a new connection object and assigns the socket.
-        connected_client *new_connection = new connected_client(new_client_socket, this);
+        // Hands every client accepted on this wake up to the dispatcher together.
+        if(!accepted.empty())
+            this->accept_clients(accepted, nullptr);
+
+    }
+
+}
+
+/* Creates a socket bound to the server's address, returns a negative value on errors. */
+int server::open_listener(bool reuse_port) {
+
+    // Creates a TCP socket.
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener < 0) {
+        this->server_status = listener;
+        return listener;
+    }
+
+    // Sets the socket to be non-blocking (with io_uring the submitted accepts wait for connections themselves).
+    if(this->backend == ib_Epoll) {
+        int flags = fcntl(listener, F_GETFL);
+        flags |= O_NONBLOCK;
+        fcntl(listener, F_SETFL, flags);
+    }
+
+    // Allows more than one socket to be bound to the port.
+    if(reuse_port) {
+        int enable = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+    }
+
+    // Binds the server to the socket.
+    int status = bind(listener, (struct sockaddr *) &(this->server_address), sizeof(this->server_address));
+    if(status < 0) {
+        this->server_status = status;
+        close(listener);
+        return status;
+    }
+
+    // Starts listening right away, only once for the whole execution.
+    status = listen(listener, this->backlog);
+    if(status < 0) {
+        this->server_status = status;
+        close(listener);
+        return status;
+    }
+
+    return listener;
+
+}
+
+/* Creates a connection for a newly accepted socket and adds it to the new clients queue, on sharded mode the accepting reactor keeps owning it. */
+void server::accept_client(int new_client_socket, reactor *owner) { this->accept_clients(std::vector<int>(1, new_client_socket), owner); }
+
+/* Creates the connections for a group of accepted sockets, adding them to the new clients queue and waking the dispatcher up only once. */
+void server::accept_clients(const std::vector<int> &new_client_sockets, reactor *owner) {
+
+    // Creates the new connection objects and assigns the sockets.
+    std::vector<connected_client*> new_connections;
+    new_connections.reserve(new_client_sockets.size());
+    for(auto iter = new_client_sockets.begin(); iter != new_client_sockets.end(); iter++) {
+
+        connected_client *new_connection = new connected_client(*iter, this, this->send_queue_capacity);
 
         if(new_connection == nullptr) { // Checks for errors creating the connection.
             std::cerr << COLOR_RED << "Error creating new connection!" << COLOR_DEFAULT << std::endl;
+            close(*iter);
             continue;
         }
 
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-        // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
-        this->updating_new_clients.lock();
-        // ENTER CRITICAL REGION =======================================
-        /* Adds the new connection to the queue, modifying the queue can cause problems if some 
-        client handler is reading it at the same time, thus a semaphore is used. */
-        this->new_clients.push(new_connection);
-        // EXIT CRITICAL REGION ========================================
-        // Exits the critical region, and opens the semaphore.
-        this->updating_new_clients.unlock();
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
+        new_connections.push_back(new_connection);
+
+    }
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->updating_new_clients.lock();
+    // ENTER CRITICAL REGION =======================================
+    /* Adds the new connections to the queue, modifying the queue can cause problems if some 
+    client handler is reading it at the same time, thus a semaphore is used. */
+    for(auto iter = new_connections.begin(); iter != new_connections.end(); iter++)
+        this->new_clients.push(std::make_pair(*iter, owner));
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->updating_new_clients.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    for(auto iter = new_connections.begin(); iter != new_connections.end(); iter++)
+        std::cerr << COLOR_BLUE << "Client just connected with socket " << (*iter)->get_socket() << "!" << COLOR_DEFAULT << std::endl;
+    this->atmc_accepted_count.fetch_add(new_connections.size(), std::memory_order_relaxed);
+
+    // Wakes up the dispatcher to register the clients.
+    if(!new_connections.empty())
+        this->wake_dispatcher();
+
+}
+
+/* Accepts the connections waiting on a non-blocking listener (up to a batch), returns true if more connections may still be waiting. */
+bool server::accept_pending(int listener, std::vector<int> &accepted) {
+
+    while(accepted.size() < max_accept_batch) {
+
+        // The sockets are created non-blocking, as the reactors need them.
+        int new_client_socket = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if(new_client_socket < 0) {
+            if(errno == EINTR) // Interrupted, tries again.
+                continue;
+            if(errno != EAGAIN && errno != EWOULDBLOCK) // Other types of errors.
+                std::cerr << COLOR_RED << "Unidentified connection error!" << COLOR_DEFAULT << std::endl;
+            return false;
+        }
+
+        accepted.push_back(new_client_socket);
+
+    }
+
+    return true;
+
+}
+
+/* Wakes up the thread processing requests, used when a new client connects or when a client disconnects. (thread-safe) */
+void server::wake_dispatcher() {
 
-        std::cerr << COLOR_BLUE << "Client just connected with socket " << new_connection->get_socket() << "!" << COLOR_DEFAULT << std::endl;
+    // Marks when the dispatcher was asked to wake up, to measure how long it takes.
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t expected = 0;
+    this->atmc_wakeup_requested.compare_exchange_strong(expected, now);
 
+    uint64_t value = 1;
+    if(write(this->dispatcher_fd, &value, sizeof(value)) < 0) {
+        // The counter is already full, so the dispatcher will wake up anyways.
     }
 
 }
@@ -295,15 +525,16 @@ void server::check_connections() {
              std::cerr << COLOR_YELLOW << "Client with socket " << (*iter)->get_socket() << " disconnected!" << COLOR_DEFAULT << std::endl;
             // Kills the client.
             kill_client(*iter);
-            // Removes the client from the list.
-            this->clients.erase(iter);
-            // Restarts the check.
-            iter = this->clients.begin();
+            // Removes the client from the list and continues from the next one.
+            iter = this->clients.erase(iter);
             continue;
         }
         iter++;   
     }
 
+    // New clients grouped by the reactor that will own them, so each reactor is woken up only once for a whole wave of connections.
+    std::map<reactor*, std::vector<connected_client*>> attachments;
+
     // --------------------------------------------------------------------------------------------------------------------------------------------------
     // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
     this->updating_new_clients.lock();
@@ -312,10 +543,17 @@ void server::check_connections() {
     // Transfers any new clients to the main list.
     while (!this->new_clients.empty()) {
         // Gets a new client from the queue.
-        connected_client *new_client = this->new_clients.front();
-        // Spawns the thread to handle the client connection.
-        new_client->spawn_handle();
+        connected_client *new_client = this->new_clients.front().first;
+        reactor *owner = this->new_clients.front().second;
+        // Gives the client's socket back to the reactor that accepted it or to the next reactor.
+        if(owner == nullptr) {
+            owner = this->reactors[this->next_reactor];
+            this->next_reactor = (this->next_reactor + 1) % this->reactors.size();
+        }
+        new_client->set_handle(this->handles.insert(new_client)); // Gives the client a handle before any request is made.
+        attachments[owner].push_back(new_client);
         this->clients.insert(new_client); // Transfer the client.
+        this->nicknames[new_client->get_nickname()] = new_client; // Indexes it's initial nickname.
         this->new_clients.pop(); // Removes from the queue.
     }    
 
@@ -324,6 +562,118 @@ void server::check_connections() {
     this->updating_new_clients.unlock();
     // --------------------------------------------------------------------------------------------------------------------------------------------------
 
+    // Gives the sockets to their reactors, outside of the critical region so the threads accepting connections are not blocked.
+    for(auto iter = attachments.begin(); iter != attachments.end(); iter++) {
+        iter->first->attach(iter->second);
+        this->attach_batch_count++;
+    }
+
+}
+
+/* Sleeps until there's a request, a new client or a dead client to be handled. */
+void server::wait_for_work() {
+
+    // Marks the dispatcher as sleeping and checks the queue again, so a request made before the mark was seen is not missed.
+    this->atmc_dispatcher_sleeping = true;
+
+    // Orders the mark before reading the queue, matching the fence of make_requests, so either the dispatcher sees the request or the client sees
+    // the mark (the queue's own acquire/release is not enough for a store followed by a load).
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    bool has_request = !this->request_queue.empty();
+
+    // Sleeps until the event is signaled (new clients, dead clients and signals always signal it).
+    if(!has_request && !atmc_close_server_flag && !atmc_print_diagnostics_flag) {
+        struct pollfd event;
+        event.fd = this->dispatcher_fd;
+        event.events = POLLIN;
+        poll(&event, 1, -1);
+    }
+
+    this->atmc_dispatcher_sleeping = false;
+
+    // Resets the event.
+    uint64_t value;
+    while(read(this->dispatcher_fd, &value, sizeof(value)) > 0);
+
+    // Measures how long it took to wake up.
+    int64_t requested = this->atmc_wakeup_requested.exchange(0);
+    if(requested != 0) {
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        int64_t latency = now - requested;
+        this->wakeup_count++;
+        this->total_wakeup_latency += latency;
+        if(latency > this->max_wakeup_latency)
+            this->max_wakeup_latency = latency;
+    }
+
+    // Prints the diagnostics if asked to.
+    if(atmc_print_diagnostics_flag.exchange(false))
+        this->print_diagnostics();
+
+}
+
+/* Counts the requests executed, measuring how many are executed each second. */
+void server::count_requests(size_t count) {
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    // A window starts with it's first batch, so the time the dispatcher was sleeping is not measured.
+    if(this->rate_window_count == 0)
+        this->rate_window_start = now;
+
+    this->executed_count += count;
+    this->rate_window_count += count;
+    this->rate_window_last = now;
+
+    // Closes the current window once a second has passed.
+    if(now - this->rate_window_start >= std::chrono::seconds(1))
+        this->close_rate_window();
+
+}
+
+/* Closes the current window of the request rate, updating the peak rate. */
+void server::close_rate_window() {
+
+    if(this->rate_window_count == 0)
+        return;
+
+    // Windows closed before a second passed (a burst followed by silence) executed all their requests in that second.
+    std::chrono::duration<double> elapsed = this->rate_window_last - this->rate_window_start;
+    double rate = this->rate_window_count / std::max(elapsed.count(), 1.0);
+    if(rate > this->peak_request_rate)
+        this->peak_request_rate = rate;
+
+    this->rate_window_count = 0;
+
+}
+
+/* Prints information about the server's performance. */
+void server::print_diagnostics() {
+
+    std::cerr << COLOR_BOLD_CYAN << "Diagnostics:" << COLOR_DEFAULT << std::endl;
+    std::cerr << "\tClients: " << this->clients.size() << ", channels: " << this->channel_ids.size() << ", reactors: " << this->reactors.size() << std::endl;
+    std::cerr << "\tDispatcher wake ups: " << this->wakeup_count;
+    if(this->wakeup_count > 0)
+        std::cerr << " (average latency: " << (this->total_wakeup_latency / (int64_t)this->wakeup_count) / 1000 << "us, max: " << this->max_wakeup_latency / 1000 << "us)";
+    std::cerr << std::endl;
+    // Counts the requests of the last window even if a second didn't pass yet.
+    this->close_rate_window();
+    std::cerr << "\tRequests: " << this->executed_count << " executed (peak: " << (uint64_t)this->peak_request_rate << " per second)" << std::endl;
+    uint64_t large_fanouts = this->atmc_large_fanout_count;
+    std::cerr << "\tLarge channel messages: " << large_fanouts;
+    if(large_fanouts > 0)
+        std::cerr << " (average time to last member: " << (this->atmc_total_fanout_time / (int64_t)large_fanouts) / 1000 << "us, max: " << this->atmc_max_fanout_time / 1000 << "us)";
+    std::cerr << std::endl;
+    std::cerr << "\tExecutors: " << this->executor->get_worker_count() + 1 << " threads, " << this->parallel_group_count << " parallel groups of channels (" << this->parallel_strand_count << " channels)" << std::endl;
+    std::cerr << "\tConnections: " << this->atmc_accepted_count << " accepted, attached to the reactors in " << this->attach_batch_count << " batches" << std::endl;
+    std::cerr << "\tRequest arenas: " << request_arena::get_request_count() << " requests stored on " << request_arena::get_block_count() << " blocks allocated" << std::endl;
+    std::cerr << "\tMessage buffers: " << message_buffer::get_allocation_count() << " allocated, " << message_buffer::get_live_count() << " alive (" << message_buffer::get_live_bytes() << " bytes)" << std::endl;
+
+    // Round trip times measured for each client and how long the server waits for their acknowledgements.
+    for(auto iter = this->clients.begin(); iter != this->clients.end(); iter++)
+        std::cerr << "\tClient with socket " << (*iter)->get_socket() << " (" << (*iter)->get_nickname() << "): RTT " << (*iter)->get_rtt().count() << "us, RTO " << (*iter)->get_acknowledge_timeout().count() / 1000 << "ms" << std::endl;
+
 }
 
 /* Checks for channels that became empty and can be deleted. */
@@ -333,11 +683,13 @@ void server::check_channels() {
     while (!this->empty_channels.empty()) {
 
         // Gets the start of the queue.
-        std::string target_name = this->empty_channels.front();
-        this->empty_channels.pop(); // Removes the name from the queue.
+        channel_id target_id = this->empty_channels.front();
+        this->empty_channels.pop(); // Removes the id from the queue.
 
-        // Deletes the channel.
-        this->delete_channel(target_name);
+        // Deletes the channel, unless it got members again or was already deleted since it became empty.
+        channel *target = this->get_channel_ref(target_id);
+        if(target != nullptr && target->is_empty())
+            this->delete_channel(target_id);
 
     } 
 
@@ -353,18 +705,22 @@ void server::kill_client(connected_client *connection) {
     if(target_channel != nullptr) {
 
         // Removes the client from current channel.
-        target_channel->remove_member(connection->get_socket());
+        target_channel->remove_member(connection->get_handle());
 
         // Sets the client to being in no channel.
-        connection->set_channel("NONE", cr_No_channel);
+        connection->set_channel(no_channel, cr_No_channel);
 
         // Adds the channel to the empty list if it became empty.
         if(target_channel->is_empty()) {
             std::cerr << "Channel " << target_channel->get_name() << " is empty and will soon be deleted!" << std::endl;
-            this->empty_channels.push(target_channel->get_name());
+            this->empty_channels.push(target_channel->get_id());
         }
     }
 
+    // The nickname can be used by other clients now and the requests still queued for this client are cancelled.
+    this->nicknames.erase(connection->get_nickname());
+    this->handles.remove(connection->get_handle());
+
     // Deletes the client connection.
     delete connection;
 
@@ -374,49 +730,65 @@ void server::kill_client(connected_client *connection) {
 // Creates/deletes channels =====================================================================================================================================
 // ==============================================================================================================================================================
 
-bool server::create_channel(const std::string &channel_name, const int admin_socket) {
+/* Creates a new channel on this server, returns null if the name is invalid. */
+channel *server::create_channel(const std::string &channel_name, client_handle admin) {
 
     // Checks if the channel name is valid.
     if(!channel::is_valid_channel_name(channel_name))
-        return false;
+        return nullptr;
+
+    // Gets an id for the channel, reusing the ones of deleted channels.
+    channel_id id;
+    if(!this->free_channel_ids.empty()) {
+        id = this->free_channel_ids.back();
+        this->free_channel_ids.pop_back();
+    } else {
+        // The id 0 is kept for clients that are on no channel.
+        if(this->channels.empty())
+            this->channels.push_back(nullptr);
+        id = this->channels.size();
+        this->channels.push_back(nullptr);
+    }
 
-    // Creates the channel.
-    channel new_channel(channel_name);
+    // Creates the channel and interns it's name.
+    channel *new_channel = new channel(id, channel_name);
+    this->channels[id] = new_channel;
+    this->channel_ids[channel_name] = id;
 
     // Adds the admin to the channel.
-    new_channel.add_member(admin_socket);
-
-    // Creates the new channel and adds it to the map.
-    this->channels.insert(std::make_pair(channel_name, new_channel));
+    new_channel->add_member(admin);
 
     std::cerr << COLOR_BLUE << "Channel " << channel_name << " created!" << COLOR_DEFAULT << std::endl;
 
-    return true;
+    return new_channel;
 
 }
 
 /* Deletes an empty channel on this server. */
-bool server::delete_channel(const std::string &channel_name) {
+bool server::delete_channel(channel_id id) {
 
     // Gets a reference to the channel.
-    channel *target = this->get_channel_ref(channel_name);
+    channel *target = this->get_channel_ref(id);
 
     // Checks if the channel being deleted exists.
     if(target == nullptr) {
-        std::cerr << COLOR_BOLD_RED << "Channel " + channel_name + " doesn't exist!" << COLOR_DEFAULT << std::endl;
+        std::cerr << COLOR_BOLD_RED << "Channel " << id << " doesn't exist!" << COLOR_DEFAULT << std::endl;
         return false;
     }
 
     // Gives an error if the channel is not empty.
     if(!target->is_empty()) {
-        std::cerr << COLOR_BOLD_RED << "Channel " + channel_name + " is not empty!" << COLOR_DEFAULT << std::endl;
+        std::cerr << COLOR_BOLD_RED << "Channel " + target->get_name() + " is not empty!" << COLOR_DEFAULT << std::endl;
         return false;
     }
 
-    /* Erases the channel from the map. */
-    this->channels.erase(channel_name);
+    std::cerr << COLOR_YELLOW << "Channel " << target->get_name() << " deleted!" << COLOR_DEFAULT << std::endl;
 
-    std::cerr << COLOR_YELLOW << "Channel " << channel_name << " deleted!" << COLOR_DEFAULT << std::endl;
+    /* Erases the channel from the table, it's id can be used again. */
+    this->channel_ids.erase(target->get_name());
+    this->channels[id] = nullptr;
+    this->free_channel_ids.push_back(id);
+    delete target;
 
     return true;
 
@@ -426,25 +798,16 @@ bool server::delete_channel(const std::string &channel_name) {
 // Getters ======================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Returns a reference to a client with a certain socket. */
-connected_client *server::get_client_ref(int socket) {
-
-    // Searches for the client in the list.
-    for(auto iter = this->clients.begin(); iter != this->clients.end(); iter++)
-        if((*iter)->get_socket() == socket)
-            return (*iter);
-
-    return nullptr;
-
-}
+/* Returns a reference to a client with a certain handle. */
+connected_client *server::get_client_ref(client_handle handle) { return this->handles.get(handle); }
 
 /* Returns a reference to a client with a certain nickname. */
 connected_client *server::get_client_ref(const std::string &nickname) {
 
-    // Searches for the client in the list.
-    for(auto iter = this->clients.begin(); iter != this->clients.end(); iter++)
-        if((*iter)->get_nickname().compare(nickname) == 0)
-            return (*iter);
+    // Searches for the client in the nickname index.
+    auto iter = this->nicknames.find(nickname);
+    if(iter != this->nicknames.end())
+        return iter->second;
 
     return nullptr;
 
@@ -453,152 +816,358 @@ connected_client *server::get_client_ref(const std::string &nickname) {
 /* Returns a reference to a channel with a certain name. */
 channel *server::get_channel_ref(const std::string &channel_name) {
 
-    // Searches for the channel in the list.
-    auto iter = channels.find(channel_name);
-    if(iter != this->channels.end())
-        return &(iter->second);
+    // Searches for the channel's id in the interned names.
+    auto iter = this->channel_ids.find(channel_name);
+    if(iter != this->channel_ids.end())
+        return this->channels[iter->second];
 
     return nullptr;
 
 }
 
+/* Returns a reference to a channel with a certain id. */
+channel *server::get_channel_ref(channel_id id) {
+
+    if(id == no_channel || id >= this->channels.size())
+        return nullptr;
+
+    return this->channels[id];
+
+}
+
 // ==============================================================================================================================================================
 // Requests =====================================================================================================================================================
 // ==============================================================================================================================================================
 
-/* Makes a request to the server, that will be added to the request queue and handled as soon as possible (gets a lock to the request_queue during execution) */
-void server::make_request(connected_client *const origin, const std::string &content) {
+/* Executes a batch of requests, messages to different channels are executed in parallel and the other requests alone, in the order they were made. */
+void server::execute_batch(const std::vector<request> &batch) {
+
+    for(auto iter = batch.begin(); iter != batch.end(); iter++) {
+
+        // Requests that change clients or channels may touch any channel, so every message before them is executed first and they're executed alone.
+        if(iter->get_type() != rt_Send) {
+            this->run_strands();
+            this->execute_request(*iter);
+            continue;
+        }
+
+        // Messages only touch their channel's members, which are only on that channel, so they're kept in order on the strand of the origin's channel
+        // (messages from clients that left or are not on a channel only answer the origin, and are kept on the strand of no channel).
+        connected_client *origin = this->get_client_ref(iter->get_origin());
+        channel_id strand_channel = (origin != nullptr) ? origin->get_channel() : no_channel;
+
+        auto found = this->strand_indexes.find(strand_channel);
+        if(found == this->strand_indexes.end()) {
+            found = this->strand_indexes.emplace(strand_channel, this->strand_indexes.size()).first;
+            if(this->strands.size() < this->strand_indexes.size())
+                this->strands.emplace_back();
+        }
+        this->strands[found->second].push_back(&(*iter));
+
+    }
+
+    this->run_strands();
+
+}
+
+/* Runs the strands of messages gathered by execute_batch, returns when all of them were executed. */
+void server::run_strands() {
+
+    size_t strand_count = this->strand_indexes.size();
+    if(strand_count == 0)
+        return;
+
+    // A single strand or no other threads to share it with are executed right away.
+    if(strand_count == 1 || this->executor->get_worker_count() == 0) {
+
+        for(size_t i = 0; i < strand_count; i++)
+            for(auto iter = this->strands[i].begin(); iter != this->strands[i].end(); iter++)
+                this->execute_request(**iter);
+
+    } else {
+
+        // Each strand becomes a task, the pool returns after every task finished, so the next requests see everything they did.
+        this->strand_tasks.clear();
+        for(size_t i = 0; i < strand_count; i++) {
+            std::vector<const request*> *strand = &this->strands[i];
+            this->strand_tasks.push_back([this, strand]() {
+                for(auto iter = strand->begin(); iter != strand->end(); iter++)
+                    this->execute_request(**iter);
+            });
+        }
+        this->executor->run(this->strand_tasks);
+
+        this->parallel_group_count++;
+        this->parallel_strand_count += strand_count;
+
+    }
+
+    // Keeps the strands' memory for the next batches.
+    for(size_t i = 0; i < strand_count; i++)
+        this->strands[i].clear();
+    this->strand_indexes.clear();
+
+}
+
+/* Executes a request taken from the request queue. */
+void server::execute_request(const request &current_request) {
+
+    // Gets the client that sent this request.
+    connected_client *origin = this->get_client_ref(current_request.get_origin());
+    if(origin == nullptr) { // Checks if the client who sent the request is still avaliable.
+        std::cerr << COLOR_YELLOW << "Request cancelled! (Client " << handle_to_string(current_request.get_origin()) << " is no longer avaliable)" << COLOR_DEFAULT << std::endl;
+        return;
+    }
+
+    // Gets the data from the request, only the commands that keep it as a name copy it.
+    const char *data = current_request.get_data();
+    size_t size = current_request.get_size();
+
+    // Stores if the request failed because the client doesn't have needed admin rights.
+    // Used to send a warning to the client later.
+    bool admin_failed = false;
+
+    // ! NOTE: /ack and /ping request are handled immediately and are not put on the request queue to avoid delays.
+    // Checks for the type of the request and executes it properly.
+    switch (current_request.get_type()) {
+
+        case rt_Send:
+            this->send_request(origin, data, size);
+            break;
+
+        case rt_Nickname:
+            this->nickname_request(origin, std::string(data, size));
+            break;
+
+        case rt_Join:
+            this->join_request(origin, std::string(data, size));
+            break;
+
+        case rt_Admin_kick:
+            if(origin->get_role() == cr_Admin)
+                this->kick_request(origin, std::string(data, size));
+            else admin_failed = true;
+            break;
+
+        case rt_Admin_mute:
+            if(origin->get_role() == cr_Admin)
+                this->toggle_mute_request(origin, std::string(data, size), true);
+            else admin_failed = true;
+            break;
+
+        case rt_Admin_unmute:
+            if(origin->get_role() == cr_Admin)
+                this->toggle_mute_request(origin, std::string(data, size), false);
+            else admin_failed = true;
+            break;
+
+        case rt_Admin_whois:
+            if(origin->get_role() == cr_Admin)
+                this->whois_request(origin, std::string(data, size));
+            else admin_failed = true;
+            break;
+        
+        default:
+            break;
+    }
+
+    if(admin_failed) // Sends a warning to the client that a request failed because it's not an admin.
+        origin->send(get_server_reply(sr_Not_admin));
+
+}
+
+/* Makes a group of requests to the server, that will be added to the request queue and handled as soon as possible. (doesn't lock, many clients can make requests at the same time) */
+void server::make_requests(connected_client *const origin, const std::vector<request_payload> &contents) {
+
+    // Queues every request before waking the dispatcher up, so it's done only once for the whole group.
+    bool queued = false;
+    for(auto iter = contents.begin(); iter != contents.end(); iter++)
+        queued |= this->queue_request(origin, *iter);
 
-    // Gets the origin socket to be used in execution.
+    if(!queued)
+        return;
+
+    // Orders the requests before reading the dispatcher's mark, matching the fence of wait_for_work.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Wakes up the dispatcher only if it's sleeping.
+    if(this->atmc_dispatcher_sleeping.exchange(false))
+        this->wake_dispatcher();
+
+}
+
+// Checks if the command of a request (not null terminated) is the given command.
+static bool is_command(const char *command, size_t size, const char *expected) { return size == strlen(expected) && memcmp(command, expected, size) == 0; }
+
+/* Parses a request and adds it to the request queue, returns false if it was not added. (called by make_requests) */
+bool server::queue_request(connected_client *const origin, const request_payload &content) {
+
+    // Gets the origin socket, used on the logs.
     int origin_socket = origin->get_socket();
 
+    // Only the start of the request is shown on the logs.
+    size_t logged_size = (content.size <= 20) ? content.size : 20;
+    const char *logged_ellipsis = (content.size <= 20) ? "" : "...";
+
     // Checks for a valid request, any empty request or one without a "/" as the first character can be discarded.
-    if(!content.empty() && content[0] == '/') {
-
-        // Gets the position that divides the request command from it's data.
-        size_t delimiter = content.find(' ');
-
-        // Breaks the request into command and data parts.
-        std::string command = content.substr(0,delimiter);
-        std::string data = std::string(); // Initializes as empty string.
-        try { // Tries getting the data portion. (try-catch is needed because sometimes the data portion may not exist)
-            data = content.substr(delimiter+1,content.size());
-        } catch (const std::out_of_range& oor) {
-            // Does nothing, simple leaves data as an empty string.
-        }
+    if(content.size > 0 && content.data[0] == '/') {
+
+        // Breaks the request into command and data parts, they're read in place from the arena (the data is empty if there's no space).
+        const char *delimiter = (const char*)memchr(content.data, ' ', content.size);
+        size_t command_size = (delimiter != nullptr) ? delimiter - content.data : content.size;
+        const char *data = (delimiter != nullptr) ? delimiter + 1 : content.data + content.size;
+        size_t data_size = content.data + content.size - data;
 
         // ! NOTE: /ack and /ping request are handled immediately and are not put on the request queue to avoid delays.
         // Detects the type of the request.
         request_type r_type = rt_Invalid;
-        if(!data.empty()) {
-            if (command.compare("/send") == 0)
+        if(data_size > 0) {
+            if (is_command(content.data, command_size, "/send"))
                 r_type = rt_Send;
-            else if(command.compare("/nickname") == 0)
+            else if(is_command(content.data, command_size, "/nickname"))
                 r_type = rt_Nickname;           
-            else if(command.compare("/join") == 0)
+            else if(is_command(content.data, command_size, "/join"))
                 r_type = rt_Join;
-            else if(command.compare("/kick") == 0)
+            else if(is_command(content.data, command_size, "/kick"))
                 r_type = rt_Admin_kick;
-            else if(command.compare("/mute") == 0)
+            else if(is_command(content.data, command_size, "/mute"))
                 r_type = rt_Admin_mute;
-            else if(command.compare("/unmute") == 0)
+            else if(is_command(content.data, command_size, "/unmute"))
                 r_type = rt_Admin_unmute;
-            else if(command.compare("/whois") == 0)
+            else if(is_command(content.data, command_size, "/whois"))
                 r_type = rt_Admin_whois;
         }
 
         // If the request type is invalid sends a warning back to the client and ignores it.
         if(r_type == rt_Invalid) {
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " invalid command or command parameters!");
-            return;
+            origin->reply(get_server_reply(sr_Invalid_command));
+            request_arena::release(content.block);
+            return false;
         }
 
-        // Everything is correct, creates the request.
-        request new_request(origin_socket, r_type, data);
-
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-        // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
-        this->updating_request_queue.lock();
-        // ENTER CRITICAL REGION =======================================
-        /* Adds the new request to the queue, modifying the queue can cause problems if some client
-        handler is also adding a request or if the server is reading a request to be executed at
-        the same time, thus a semaphore is used. */
-        this->request_queue.push(new_request); // Adds the new request to the queue.
-        // EXIT CRITICAL REGION ========================================
-        // Exits the critical region, and opens the semaphore.
-        this->updating_request_queue.unlock();
-        // --------------------------------------------------------------------------------------------------------------------------------------------------
-
-        if(content.size() <= 20)
-            std::cerr << "New request from socket " << origin_socket << ": \"" << content << "\"" << std::endl;
-        else
-            std::cerr << "New request from socket " << origin_socket << ": \"" << content.substr(0, 20) << "...\"" << std::endl;            
+        // Everything is correct, creates the request and adds it to the queue, if the queue is full the request is dropped.
+        if(!this->request_queue.push(request(origin->get_handle(), r_type, data, data_size, content.block))) {
+            std::cerr << COLOR_BOLD_YELLOW << "Request queue is full! Dropping request from socket " << origin_socket << "..." << COLOR_DEFAULT << std::endl;
+            origin->reply(get_server_reply(sr_Busy));
+            request_arena::release(content.block);
+            return false;
+        }
 
-        return;
+        std::cerr << "New request from socket " << origin_socket << ": \"";
+        std::cerr.write(content.data, logged_size);
+        std::cerr << logged_ellipsis << "\"" << std::endl;
+
+        return true;
 
     }
 
-    if(content.size() <= 20)
-        std::cerr << "Invalid request from socket " << origin_socket << ": \"" << content << "\"! Ignoring..." << std::endl;
-    else
-        std::cerr << "Invalid request from socket " << origin_socket << ": \"" << content.substr(0, 20) << "...\"! Ignoring..." << std::endl;
+    std::cerr << "Invalid request from socket " << origin_socket << ": \"";
+    std::cerr.write(content.data, logged_size);
+    std::cerr << logged_ellipsis << "\"! Ignoring..." << std::endl;
+
+    request_arena::release(content.block);
+    return false;
 
 }
 
 /* Sends a message from a client to other clients on it's channel. */
-void server::send_request(connected_client *const origin, const std::string &message) {
+void server::send_request(connected_client *const origin, const char *message, size_t size) {
 
     // Gets the client's channel.
-    std::string target_channel_name = origin->get_channel();
-    channel *target_channel = this->get_channel_ref(target_channel_name);
+    channel *target_channel = this->get_channel_ref(origin->get_channel());
 
     // If the client is not on a valid channel sends an error message.
     if(target_channel == nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " you need to join a channel before sending messages!" + COLOR_DEFAULT);
+        origin->send(get_server_reply(sr_Join_before_sending));
         return;
     }
 
     // Checks if the client is not muted.
-    if(!target_channel->is_muted(origin->get_socket())) {
-
-        // Gets the client's nickname.
-        std::string client_name = origin->get_nickname();
-
-        // Gets the target sockets (channel's members).
-        std::vector<int> message_targets = target_channel->get_members();
-
-        // Sends the message to each target.
-        for(auto iter = message_targets.begin(); iter != message_targets.end(); iter++) {
-            // Gets the target client.
-            connected_client *target_client = this->get_client_ref(*iter);
-            if(target_client != nullptr) {
-                std::string complete_message = COLOR_BLUE + target_channel_name + COLOR_CYAN + " " + client_name + ": " + COLOR_DEFAULT + message;
-                target_client->send(complete_message);
-            }
+    if(!target_channel->is_muted(origin->get_handle())) {
+
+        // The payload is rendered once into a buffer shared by every target, it's freed after the last target has sent it, the prefix is kept by the
+        // client until it changes it's nickname or channel.
+        const message_handle &prefix = origin->get_message_prefix(target_channel->get_name());
+        message_handle payload(message, size);
+
+        // Gets the targets (channel's members), read in place as nothing changes the channel while sending.
+        const std::vector<channel_member> &message_targets = target_channel->get_members();
+        outgoing_message rendered(prefix, payload);
+
+        if(message_targets.size() < parallel_fanout_threshold) {
+            this->fan_out(message_targets, 0, message_targets.size(), rendered);
+            return;
+        }
+
+        // Large channels are split in chunks given to the executor's threads, each target is on a single chunk, so each send queue still has a
+        // single producer. When this already runs on a channel's strand, the thread only helps with this message's chunks and then sleeps until
+        // they finished, it never runs another strand in the middle of it, so the channel's messages stay in order (each channel has a single strand).
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        std::vector<std::function<void()>> chunks;
+        for(size_t begin = 0; begin < message_targets.size(); begin += fanout_chunk_size) {
+            size_t end = std::min(begin + fanout_chunk_size, message_targets.size());
+            chunks.push_back([this, &message_targets, begin, end, &rendered]() { this->fan_out(message_targets, begin, end, rendered); });
         }
+        this->executor->run(chunks);
+
+        // Measures how long it took until the last member's send queue had the message and it's reactor was notified.
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        this->atmc_large_fanout_count++;
+        this->atmc_total_fanout_time += elapsed;
+        int64_t max_time = this->atmc_max_fanout_time;
+        while(elapsed > max_time && !this->atmc_max_fanout_time.compare_exchange_weak(max_time, elapsed));
 
     } else { // Sends a message warning the client that it is muted.
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_YELLOW + " you are currently muted on the channel " + target_channel_name + "!" + COLOR_DEFAULT);
+        origin->send(make_server_reply(COLOR_YELLOW + " you are currently muted on the channel " + target_channel->get_name() + "!" + COLOR_DEFAULT));
         return;
     }
 
 }
 
+/* Gives a message to a range of a channel's members and notifies their reactors, each reactor only once. (called by send_request) */
+void server::fan_out(const std::vector<channel_member> &targets, size_t begin, size_t end, const outgoing_message &message) {
+
+    // Targets grouped by the reactor that owns them, so each reactor is notified only once.
+    std::map<reactor*, std::vector<connected_client*>> notifications;
+
+    // Sends the message to each target.
+    for(size_t i = begin; i < end; i++) {
+        // Gets the target client.
+        connected_client *target_client = this->get_client_ref(targets[i].handle);
+        if(target_client != nullptr) {
+            target_client->enqueue(message);
+            reactor *owner = target_client->get_reactor();
+            if(owner != nullptr)
+                notifications[owner].push_back(target_client);
+        }
+    }
+
+    // Notifies the reactors, the ones on other shards receive the whole group at once.
+    for(auto iter = notifications.begin(); iter != notifications.end(); iter++)
+        iter->first->notify_output(iter->second);
+
+}
+
 /* Tries changing the nickname of a certain client. */
 void server::nickname_request(connected_client *const origin, const std::string &nickname) {
 
     // Checks if the nickname doesn't exist on the server.
     // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
     if(this->get_client_ref(nickname) != nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " this nickname already exists!" + COLOR_DEFAULT);
+        origin->send(get_server_reply(sr_Nickname_exists));
         return;
     }
 
     // Tries updating the nickname and sends a message to the client telling the results.
-    if(origin->set_nickname(nickname))
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " your nickname was changed to " + nickname + "!");
-    else
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " this nickname is invalid! (It can't start with '#' or '&' and must not contain spaces or commas)" + COLOR_DEFAULT);
+    std::string old_nickname = origin->get_nickname();
+    if(origin->set_nickname(nickname)) {
+        // Moves the client to it's new nickname on the index.
+        this->nicknames.erase(old_nickname);
+        this->nicknames[nickname] = origin;
+        origin->send(make_server_reply(COLOR_DEFAULT + " your nickname was changed to " + nickname + "!"));
+    } else
+        origin->send(get_server_reply(sr_Invalid_nickname));
 
 }
 
@@ -607,7 +1176,7 @@ void server::join_request(connected_client *const origin, const std::string &cha
 
     // Checks for an invalid channel name, and sends a warning to the client.
     if(!channel::is_valid_channel_name(channel_name)) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " this channel name is invalid! (It can't start with '#' or '&' and must not contain spaces or commas)" + COLOR_DEFAULT);
+        origin->send(get_server_reply(sr_Invalid_channel_name));
         return;
     }
 
@@ -618,37 +1187,34 @@ void server::join_request(connected_client *const origin, const std::string &cha
     if(target_channel != nullptr) {
 
         // Removes the client from current channel.
-        target_channel->remove_member(origin->get_socket());
+        target_channel->remove_member(origin->get_handle());
 
         // Sets the client to being in no channel.
-        origin->set_channel("NONE", cr_No_channel);
+        origin->set_channel(no_channel, cr_No_channel);
 
         // Adds the channel to the empty list if it became empty.
         if(target_channel->is_empty()) {
             std::cerr << "Channel " << target_channel->get_name() << " is empty and will soon be deleted!" << std::endl;
-            this->empty_channels.push(target_channel->get_name());
+            this->empty_channels.push(target_channel->get_id());
         }
 
     }
 
     // Gets a reference to the channel if it already exists.
-    auto iter = this->channels.find(channel_name);
-    target_channel = nullptr;
-    if(iter != this->channels.end())
-        target_channel = &(iter->second);
+    target_channel = this->get_channel_ref(channel_name);
 
     // If the reference could be obtained the channel already exists, so adds the client.
     if(target_channel != nullptr) {
-        target_channel->add_member(origin->get_socket()); // Adds the client.
-        origin->set_channel(channel_name, cr_Normal); // Sets the client channel and role.
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " you're now on channel " + channel_name + "!");
+        target_channel->add_member(origin->get_handle()); // Adds the client.
+        origin->set_channel(target_channel->get_id(), cr_Normal); // Sets the client channel and role.
+        origin->send(make_server_reply(COLOR_DEFAULT + " you're now on channel " + channel_name + "!"));
         return;
     }
 
     // If no reference was found them creates the new channel with the client as an admin.
-    create_channel(channel_name, origin->get_socket()); // Creates the channel.
-    origin->set_channel(channel_name, cr_Admin); // Sets the client channel and role.
-    origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " you're now on channel " + channel_name + " as an " + COLOR_BOLD_BLUE + "admin" + COLOR_DEFAULT + "!");
+    target_channel = create_channel(channel_name, origin->get_handle()); // Creates the channel.
+    origin->set_channel(target_channel->get_id(), cr_Admin); // Sets the client channel and role.
+    origin->send(make_server_reply(COLOR_DEFAULT + " you're now on channel " + channel_name + " as an " + COLOR_BOLD_BLUE + "admin" + COLOR_DEFAULT + "!"));
 
 }
 
@@ -662,7 +1228,7 @@ void server::kick_request(connected_client *const origin, const std::string &nic
 
     // Checks if the target client exists and sends an error message if it does not.
     if(target == nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT);
+        origin->send(make_server_reply(COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT));
         return;
     }
 
@@ -670,7 +1236,7 @@ void server::kick_request(connected_client *const origin, const std::string &nic
     shutdown(target->get_socket(), SHUT_RDWR);
 
     // Sends a message telling the admin that the client was kicked.
-    origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " \"" + nickname + "\" kicked!");
+    origin->send(make_server_reply(COLOR_DEFAULT + " \"" + nickname + "\" kicked!"));
 
 }
 
@@ -682,7 +1248,7 @@ void server::toggle_mute_request(connected_client *const origin, const std::stri
 
     // Checks if the target client exists and sends an error message if it does not.
     if(target_client == nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT);
+        origin->send(make_server_reply(COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT));
         return;
     }
 
@@ -691,18 +1257,18 @@ void server::toggle_mute_request(connected_client *const origin, const std::stri
 
     // If the admin is not on a valid channel sends an error message.
     if(target_channel == nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " you need to join a channel before doing this!" + COLOR_DEFAULT);
+        origin->send(get_server_reply(sr_Join_before_command));
         return;
     }
 
     // Ensures admin and client are in the same channel, sends an error message if they are not.
-    if(origin->get_channel().compare(target_client->get_channel()) != 0) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " you must be in the same channel as \"" + nickname + "\" to do that!" + COLOR_DEFAULT);
+    if(origin->get_channel() != target_client->get_channel()) {
+        origin->send(make_server_reply(COLOR_RED + " you must be in the same channel as \"" + nickname + "\" to do that!" + COLOR_DEFAULT));
         return;
     }   
 
     // Tries muting the target client.
-    bool success = target_channel->toggle_mute_member(target_client->get_socket(), muted);
+    bool success = target_channel->toggle_mute_member(target_client->get_handle(), muted);
 
     // Sends a message with the results.
     if(muted) {
@@ -710,22 +1276,22 @@ void server::toggle_mute_request(connected_client *const origin, const std::stri
         // Sends success message.
         if(success) {        
             // Sends message to the admin.            
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " \"" + nickname + "\" is now muted!");
+            origin->send(make_server_reply(COLOR_DEFAULT + " \"" + nickname + "\" is now muted!"));
             // Sends message to the target.
-            target_client->send(COLOR_MAGENTA + "server:" + COLOR_YELLOW + " you are now muted on the current channel!" + COLOR_DEFAULT);
+            target_client->send(get_server_reply(sr_Now_muted));
         } else // Sends an error message to the admin.
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " \"" + nickname + "\" is not currently muted!" + COLOR_DEFAULT);
+            origin->send(make_server_reply(COLOR_RED + " \"" + nickname + "\" is not currently muted!" + COLOR_DEFAULT));
 
     } else {
 
         // Sends success message.
         if(success) {
             // Sends message to the admin.            
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " \"" + nickname + "\" is no longer muted!");
+            origin->send(make_server_reply(COLOR_DEFAULT + " \"" + nickname + "\" is no longer muted!"));
             // Sends message to the target.
-            target_client->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " you are no longer muted on the current channel!");         
+            target_client->send(get_server_reply(sr_No_longer_muted));         
         } else // Sends an error message to the admin.
-            origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " \"" + nickname + "\" is not currently muted!" + COLOR_DEFAULT);
+            origin->send(make_server_reply(COLOR_RED + " \"" + nickname + "\" is not currently muted!" + COLOR_DEFAULT));
 
     }
 
@@ -739,17 +1305,17 @@ void server::whois_request(connected_client *const origin, const std::string &ni
 
     // Checks if the target client exists and sends an error message if it does not.
     if(target == nullptr) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT);
+        origin->send(make_server_reply(COLOR_RED + " could not find client with nickname \"" + nickname + "\"!" + COLOR_DEFAULT));
         return;
     }
 
     // Ensures admin and client are in the same channel, sends an error message if they are not.
-    if(origin->get_channel().compare(target->get_channel()) != 0) {
-        origin->send(COLOR_MAGENTA + "server:" + COLOR_RED + " you must be in the same channel as \"" + nickname + "\" to do that!" + COLOR_DEFAULT);
+    if(origin->get_channel() != target->get_channel()) {
+        origin->send(make_server_reply(COLOR_RED + " you must be in the same channel as \"" + nickname + "\" to do that!" + COLOR_DEFAULT));
         return;
     }
 
     // Sends a message telling the admin the IP of the target.
-    origin->send(COLOR_MAGENTA + "server:" + COLOR_DEFAULT + " the IP address of \"" + nickname + "\" is " + target->get_ip() + "!");
+    origin->send(make_server_reply(COLOR_DEFAULT + " the IP address of \"" + nickname + "\" is " + target->get_ip() + "!"));
 
 }
\ No newline at end of file
@@ -9,24 +9,58 @@
 # include "channel.hpp"
 # include "request.hpp"
 # include "connected_client.hpp"
+# include "reactor.hpp"
+# include "mpsc_queue.hpp"
+# include "client_table.hpp"
+# include "request_arena.hpp"
+# include "work_stealing_pool.hpp"
 
+# include <string>
 # include <map>
+# include <unordered_map>
 # include <queue>
+# include <vector>
+# include <functional>
 
 # include <thread>
 # include <mutex>
+# include <atomic>
+
+# include <chrono>
 
 # include <arpa/inet.h>
 # include <netinet/in.h>
 
-// Max connections backlog
-constexpr size_t backlog_length = 8;
+// Default amount of connections the kernel keeps waiting to be accepted (capped by the system's somaxconn), can be changed with --backlog.
+constexpr int default_backlog_length = 4096;
+// Amount of threads executing requests (the dispatcher included) when none is given with --executors, 0 uses one for each core.
+constexpr unsigned default_executor_count = 0;
+// Max amount of connections accepted at once before they're handed to the dispatcher.
+constexpr size_t max_accept_batch = 256;
+
+// Max amount of requests waiting to be executed, new requests are dropped when it's reached.
+constexpr size_t request_queue_capacity = 65536;
+// Max amount of requests the dispatcher takes from the queue at once.
+constexpr size_t max_request_batch = 256;
+
+// Channels with at least this many members have their messages delivered by many threads, each one taking a chunk of the members.
+constexpr size_t parallel_fanout_threshold = 4096;
+constexpr size_t fanout_chunk_size = 1024;
+
+// Amount of accepts kept submitted when using io_uring.
+constexpr unsigned uring_accept_batch = 16;
+// Max time the thread accepting connections waits before checking if the server was closed (in milliseconds).
+constexpr int accept_wait_time = 200;
 
 // Headers for classes in other files that will be used bellow.
 class channel;
 class connected_client;
+class reactor;
 class redirect_message;
 
+// Finds the connected clients by their nicknames.
+typedef std::unordered_map<std::string, connected_client*> nickname_index;
+
 // Struct for the server.
 class server
 {
@@ -36,7 +70,8 @@ class server
         // Constructors/destructors =====================================================================================================================================
         // ==============================================================================================================================================================
 
-        server(int port_number);
+        server(int port_number, io_backend backend, bool sharded, int backlog = default_backlog_length, unsigned executor_count = default_executor_count,
+            size_t send_queue_capacity = default_send_queue_capacity);
         ~server();
 
         // ==============================================================================================================================================================
@@ -53,8 +88,24 @@ class server
         // Requests =====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Makes a request to the server, that will be added to the request queue and handled as soon as possible. (gets a lock to the request_queue during execution) */
-        void make_request(connected_client *origin, const std::string &content);
+        /* Makes a group of requests to the server, that will be added to the request queue and handled as soon as possible. (doesn't lock, many clients can make requests at the same time) */
+        void make_requests(connected_client *origin, const std::vector<request_payload> &contents);
+
+        // ==============================================================================================================================================================
+        // Connections ==================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Creates a connection for a newly accepted socket and adds it to the new clients queue, on sharded mode the accepting reactor keeps owning it. */
+        void accept_client(int new_client_socket, reactor *owner);
+
+        /* Creates the connections for a group of accepted sockets, adding them to the new clients queue and waking the dispatcher up only once. */
+        void accept_clients(const std::vector<int> &new_client_sockets, reactor *owner);
+
+        /* Accepts the connections waiting on a non-blocking listener (up to a batch), returns true if more connections may still be waiting. */
+        static bool accept_pending(int listener, std::vector<int> &accepted);
+
+        /* Wakes up the thread processing requests, used when a new client connects or when a client disconnects. (thread-safe) */
+        void wake_dispatcher();
 
     private:
 
@@ -62,30 +113,90 @@ class server
         // Variables ====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Used to store information about the server socket and address. */
+        /* Used to store information about the server socket and address. (on sharded mode each reactor has it's own socket) */
         int server_socket;
         struct sockaddr_in server_address;
 
         /* Stores the status of the server */
         int server_status;
 
-        /* Used to store new clients that just connected to the server, before they are transferred to the main list that's used for processing requests. */
-        std::queue<connected_client*> new_clients;
+        /* Interface used for the sockets' I/O. */
+        io_backend backend;
+
+        /* If each reactor accepts and owns it's own clients instead of receiving them from the connections thread. */
+        bool sharded;
+
+        /* Amount of connections the kernel keeps waiting to be accepted on the listeners. */
+        int backlog;
+
+        /* Max amount of messages waiting to be sent to each client. */
+        size_t send_queue_capacity;
+
+        /* Used to store new clients that just connected to the server (and the reactor that accepted them on sharded mode), before they are transferred to the main list that's used for processing requests. */
+        std::queue<std::pair<connected_client*, reactor*>> new_clients;
         /* Used to lock the new clients list when reading or writing to it. */
         std::mutex updating_new_clients;
 
         // Used to store the clients connected to the server that are currently being listened to and who's requests are being processed.
         std::set<connected_client*> clients;
-
-        // Used to store the server's current channels.
-        std::map<std::string, channel> channels;
-        // Used to store the name of channels that became empty and need to be removed.
-        std::queue<std::string> empty_channels;
-
-        // Used to store requests that need to be executed by the server.
-        std::queue<request> request_queue;
-        // Used to lock the request queue when reading or writing to it.
-        std::mutex updating_request_queue;
+        // Finds the connected clients by their handles, used by the requests and by the channels.
+        client_table handles;
+        // Index of the connected clients by nickname, updated when they connect, change their nickname or disconnect.
+        nickname_index nicknames;
+
+        // Event loops that handle the I/O of the connected clients, one per core.
+        std::vector<reactor*> reactors;
+        // Index of the reactor that will receive the next client.
+        size_t next_reactor;
+
+        // Used to store the server's current channels, indexed by their ids (null where the id is not used, 0 is never used) and the ids that can be used again.
+        std::vector<channel*> channels;
+        std::vector<channel_id> free_channel_ids;
+        // The ids of the channel names, interned when a channel is created, the only place where channels are found by their names.
+        std::unordered_map<std::string, channel_id> channel_ids;
+        // Used to store the ids of channels that became empty and need to be removed.
+        std::queue<channel_id> empty_channels;
+
+        // Used to store requests that need to be executed by the server, the client reactors add requests and the dispatcher takes them in batches.
+        mpsc_queue<request> request_queue;
+
+        /* Event the thread processing requests sleeps on while there's nothing to do and if it's currently sleeping (new requests only wake it up if it is). */
+        int dispatcher_fd;
+        std::atomic_bool atmc_dispatcher_sleeping;
+
+        /* When the sleeping dispatcher was first asked to wake up (in nanoseconds since the clock's epoch, zero if it wasn't). */
+        std::atomic_int64_t atmc_wakeup_requested;
+
+        /* Diagnostics of how many times the dispatcher woke up and how long it took to do so (in nanoseconds). */
+        uint64_t wakeup_count;
+        int64_t total_wakeup_latency;
+        int64_t max_wakeup_latency;
+
+        /* Diagnostics of how many requests were executed and the most executed in a second (measured on windows of a second that start with a batch, the last one is closed when printed). */
+        uint64_t executed_count;
+        std::chrono::steady_clock::time_point rate_window_start;
+        std::chrono::steady_clock::time_point rate_window_last;
+        uint64_t rate_window_count;
+        double peak_request_rate;
+
+        /* Runs the requests of different channels at the same time, the requests of each channel are kept in order on a strand run by a single task. */
+        work_stealing_pool *executor;
+        std::vector<std::vector<const request*>> strands;
+        std::unordered_map<channel_id, size_t> strand_indexes;
+        std::vector<std::function<void()>> strand_tasks;
+
+        /* Diagnostics of how many groups of strands were run in parallel and how many strands they had. */
+        uint64_t parallel_group_count;
+        uint64_t parallel_strand_count;
+
+        /* Diagnostics of how many messages were sent to channels above the parallel fan-out threshold and how long it took to give them to their last member (in nanoseconds). */
+        std::atomic<uint64_t> atmc_large_fanout_count;
+        std::atomic<int64_t> atmc_total_fanout_time;
+        std::atomic<int64_t> atmc_max_fanout_time;
+
+        /* Diagnostics of how many connections were accepted and in how many groups they were given to the reactors. */
+        std::atomic<uint64_t> atmc_accepted_count;
+        uint64_t attach_batch_count;
 
         // ==============================================================================================================================================================
         // Client handling ==============================================================================================================================================
@@ -93,6 +204,12 @@ class server
 
         /* Separate thread to handle the connection of new clients */
         void t_handle_connections();
+
+        /* Accepts new clients keeping a batch of accepts submitted to io_uring. */
+        void handle_connections_uring();
+
+        /* Creates a socket bound to the server's address, returns a negative value on errors. */
+        int open_listener(bool reuse_port);
         
         /* Checks for changes in client connections. Adding or removing them if necessary. */
         void check_connections();
@@ -103,22 +220,34 @@ class server
         /* Removes the client with the given socket from the server. */
         void kill_client(connected_client *connection);
 
+        /* Sleeps until there's a request, a new client or a dead client to be handled. */
+        void wait_for_work();
+
+        /* Counts the requests executed, measuring how many are executed each second. */
+        void count_requests(size_t count);
+
+        /* Closes the current window of the request rate, updating the peak rate. */
+        void close_rate_window();
+
+        /* Prints information about the server's performance. */
+        void print_diagnostics();
+
         // ==============================================================================================================================================================
         // Creates/deletes channels =====================================================================================================================================
         // ==============================================================================================================================================================
         
-        // Creates a new channel on this server.
-        bool create_channel(const std::string &channel_name, int admin_socket);
+        // Creates a new channel on this server, returns null if the name is invalid.
+        channel *create_channel(const std::string &channel_name, client_handle admin);
 
         /* Deletes an empty channel on this server. */
-        bool delete_channel(const std::string &channel_name);
+        bool delete_channel(channel_id id);
 
         // ==============================================================================================================================================================
         // Getters ======================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* Returns a reference to a client with a certain socket. */
-        connected_client *get_client_ref(int socket);
+        /* Returns a reference to a client with a certain handle. */
+        connected_client *get_client_ref(client_handle handle);
 
         /* Returns a reference to a client with a certain nickname. */
         connected_client *get_client_ref(const std::string &nickname);
@@ -126,12 +255,31 @@ class server
         /* Returns a reference to a channel with a certain name. */
         channel *get_channel_ref(const std::string &channel_name);
 
+        /* Returns a reference to a channel with a certain id. */
+        channel *get_channel_ref(channel_id id);
+
         // ==============================================================================================================================================================
         // Requests =====================================================================================================================================================
         // ==============================================================================================================================================================
 
+        /* Parses a request and adds it to the request queue, returns false if it was not added. (called by make_requests) */
+        bool queue_request(connected_client *const origin, const request_payload &content);
+
+        /* Executes a batch of requests, messages to different channels are executed in parallel and the other requests alone, in the order they were made. */
+        void execute_batch(const std::vector<request> &batch);
+
+        /* Runs the strands of messages gathered by execute_batch, returns when all of them were executed. */
+        void run_strands();
+
+        /* Executes a request taken from the request queue. */
+        void execute_request(const request &current_request);
+
         /* Sends a message from a client to other clients on it's channel. */
-        void send_request(connected_client *const origin, const std::string &message);
+        void send_request(connected_client *const origin, const char *message, size_t size);
+
+        /* Gives a message to a range of a channel's members and notifies their reactors, each reactor only once. (called by send_request, the ranges
+        running at the same time never overlap, as a member's send queue can only have one producer) */
+        void fan_out(const std::vector<channel_member> &targets, size_t begin, size_t end, const outgoing_message &message);
 
         /* Tries changing the nickname of a certain client. */
         void nickname_request(connected_client *const origin, const std::string &nickname);
@@ -0,0 +1,140 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "message_buffer.hpp"
+
+# include <string>
+# include <new>
+
+# include <atomic>
+
+# include <cstring>
+
+// ==============================================================================================================================================================
+// Statics ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+std::atomic<uint64_t> message_buffer::atmc_allocation_count(0);
+std::atomic<uint64_t> message_buffer::atmc_live_count(0);
+std::atomic<uint64_t> message_buffer::atmc_live_bytes(0);
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+message_buffer::message_buffer(size_t size) : length(size) { this->atmc_references = 1; }
+
+/* Allocates a buffer with a copy of the data, it starts with a single reference. */
+message_buffer *message_buffer::create(const char *data, size_t size) {
+
+    // The bytes are stored right after the buffer, so a message costs a single allocation.
+    void *memory = ::operator new(sizeof(message_buffer) + size);
+    message_buffer *buffer = new(memory) message_buffer(size);
+    memcpy((char*)memory + sizeof(message_buffer), data, size);
+
+    message_buffer::atmc_allocation_count++;
+    message_buffer::atmc_live_count++;
+    message_buffer::atmc_live_bytes += size;
+
+    return buffer;
+
+}
+
+// ==============================================================================================================================================================
+// References ===================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Adds a reference to the buffer. (thread-safe) */
+void message_buffer::acquire() { this->atmc_references.fetch_add(1, std::memory_order_relaxed); }
+
+/* Removes a reference from the buffer, freeing it if it was the last one. (thread-safe) */
+void message_buffer::release() {
+
+    if(this->atmc_references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    message_buffer::atmc_live_count--;
+    message_buffer::atmc_live_bytes -= this->length;
+
+    this->~message_buffer();
+    ::operator delete((void*)this);
+
+}
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+const char *message_buffer::data() const { return (const char*)this + sizeof(message_buffer); }
+
+size_t message_buffer::size() const { return this->length; }
+
+uint64_t message_buffer::get_allocation_count() { return message_buffer::atmc_allocation_count; }
+
+uint64_t message_buffer::get_live_count() { return message_buffer::atmc_live_count; }
+
+uint64_t message_buffer::get_live_bytes() { return message_buffer::atmc_live_bytes; }
+
+// ==============================================================================================================================================================
+// Handles ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+message_handle::message_handle() { this->buffer = nullptr; }
+
+message_handle::message_handle(const std::string &text) { this->buffer = message_buffer::create(text.data(), text.size()); }
+
+message_handle::message_handle(const char *data, size_t size) { this->buffer = message_buffer::create(data, size); }
+
+message_handle::message_handle(const message_handle &other) {
+
+    this->buffer = other.buffer;
+    if(this->buffer != nullptr)
+        this->buffer->acquire();
+
+}
+
+message_handle::message_handle(message_handle &&other) {
+
+    this->buffer = other.buffer;
+    other.buffer = nullptr;
+
+}
+
+message_handle::~message_handle() {
+
+    if(this->buffer != nullptr)
+        this->buffer->release();
+
+}
+
+message_handle &message_handle::operator=(const message_handle &other) {
+
+    // Acquires first, so assigning a handle to itself doesn't free the buffer.
+    if(other.buffer != nullptr)
+        other.buffer->acquire();
+    if(this->buffer != nullptr)
+        this->buffer->release();
+    this->buffer = other.buffer;
+
+    return *this;
+
+}
+
+message_handle &message_handle::operator=(message_handle &&other) {
+
+    if(this != &other) {
+        if(this->buffer != nullptr)
+            this->buffer->release();
+        this->buffer = other.buffer;
+        other.buffer = nullptr;
+    }
+
+    return *this;
+
+}
+
+const char *message_handle::data() const { return (this->buffer != nullptr) ? this->buffer->data() : ""; }
+
+size_t message_handle::size() const { return (this->buffer != nullptr) ? this->buffer->size() : 0; }
@@ -0,0 +1,119 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef MESSAGE_BUFFER_H
+# define MESSAGE_BUFFER_H
+
+# include <string>
+
+# include <atomic>
+
+# include <cstddef>
+# include <cstdint>
+
+// Immutable text shared by the messages of many clients, it's reference count and it's bytes are stored in a single allocation that is freed when the last
+// reference is released.
+class message_buffer
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Allocates a buffer with a copy of the data, it starts with a single reference. */
+        static message_buffer *create(const char *data, size_t size);
+
+        message_buffer(const message_buffer&) = delete;
+        message_buffer &operator=(const message_buffer&) = delete;
+
+        // ==============================================================================================================================================================
+        // References ===================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Adds a reference to the buffer. (thread-safe) */
+        void acquire();
+
+        /* Removes a reference from the buffer, freeing it if it was the last one. (thread-safe) */
+        void release();
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the bytes stored and how many they are. */
+        const char *data() const;
+        size_t size() const;
+
+        /* Returns how many buffers were allocated since the server started, how many are still alive and how many bytes they hold. (used for diagnostics) */
+        static uint64_t get_allocation_count();
+        static uint64_t get_live_count();
+        static uint64_t get_live_bytes();
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Amount of references to this buffer and the amount of bytes stored right after it. */
+        std::atomic<unsigned> atmc_references;
+        const size_t length;
+
+        /* Allocation statistics shared by every buffer. */
+        static std::atomic<uint64_t> atmc_allocation_count;
+        static std::atomic<uint64_t> atmc_live_count;
+        static std::atomic<uint64_t> atmc_live_bytes;
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Only created by create(), as the bytes are allocated together with the buffer. */
+        message_buffer(size_t size);
+
+};
+
+// Reference to a message buffer, copying it only adds a reference to the same buffer.
+class message_handle
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        message_handle();
+        message_handle(const std::string &text);
+        message_handle(const char *data, size_t size);
+        message_handle(const message_handle &other);
+        message_handle(message_handle &&other);
+        ~message_handle();
+
+        message_handle &operator=(const message_handle &other);
+        message_handle &operator=(message_handle &&other);
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the bytes of the buffer referenced and how many they are (empty if there's no buffer). */
+        const char *data() const;
+        size_t size() const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* The buffer referenced, may be null. */
+        message_buffer *buffer;
+
+};
+
+# endif
@@ -0,0 +1,143 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef MPSC_QUEUE_H
+# define MPSC_QUEUE_H
+
+# include <vector>
+
+# include <atomic>
+
+# include <cstddef>
+# include <cstdint>
+
+/* Bounded lock-free queue where many threads push and a single thread pops. Each cell has a sequence number that tells if it's
+free for the producer that reserved it's position or ready for the consumer, so producers only compete on a single atomic
+increment and the consumer never takes a lock. */
+template <typename T>
+class mpsc_queue
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Creates a queue, the capacity is rounded up to a power of two. */
+        mpsc_queue(size_t capacity) {
+
+            size_t size = 1;
+            while(size < capacity)
+                size <<= 1;
+
+            this->cells = new cell[size];
+            this->mask = size - 1;
+
+            // Each cell starts free for the producer that gets it's position.
+            for(size_t i = 0; i < size; i++)
+                this->cells[i].sequence.store(i, std::memory_order_relaxed);
+
+            this->enqueue_position.store(0, std::memory_order_relaxed);
+            this->dequeue_position = 0;
+
+        }
+
+        ~mpsc_queue() { delete[] this->cells; }
+
+        mpsc_queue(const mpsc_queue&) = delete;
+        mpsc_queue &operator=(const mpsc_queue&) = delete;
+
+        // ==============================================================================================================================================================
+        // Producers ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Adds an item to the queue, returns false if the queue is full. (thread-safe) */
+        bool push(const T &item) {
+
+            size_t position = this->enqueue_position.load(std::memory_order_relaxed);
+            cell *target;
+
+            // Reserves a position.
+            while(true) {
+
+                target = &this->cells[position & this->mask];
+                size_t sequence = target->sequence.load(std::memory_order_acquire);
+                intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+                if(difference == 0) { // The cell is free, tries taking it.
+                    if(this->enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                        break;
+                } else if(difference < 0) // The consumer still didn't take the item from the last lap.
+                    return false;
+                else // Another producer took the position, tries again.
+                    position = this->enqueue_position.load(std::memory_order_relaxed);
+
+            }
+
+            // Stores the item and publishes it to the consumer.
+            target->data = item;
+            target->sequence.store(position + 1, std::memory_order_release);
+
+            return true;
+
+        }
+
+        // ==============================================================================================================================================================
+        // Consumer =====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Takes up to max_count items at once, returns how many were taken. (only called by the consumer) */
+        size_t pop_batch(std::vector<T> &items, size_t max_count) {
+
+            size_t count = 0;
+            while(count < max_count) {
+
+                cell *target = &this->cells[this->dequeue_position & this->mask];
+
+                // Stops on the first item that was not published yet.
+                if(target->sequence.load(std::memory_order_acquire) != this->dequeue_position + 1)
+                    break;
+
+                items.push_back(std::move(target->data));
+
+                // Frees the cell for the producers of the next lap.
+                target->sequence.store(this->dequeue_position + this->mask + 1, std::memory_order_release);
+                this->dequeue_position++;
+                count++;
+
+            }
+
+            return count;
+
+        }
+
+        /* Checks if there's no item ready to be taken. (only called by the consumer) */
+        bool empty() const {
+            return this->cells[this->dequeue_position & this->mask].sequence.load(std::memory_order_acquire) != this->dequeue_position + 1;
+        }
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* A position of the queue. */
+        struct cell {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        cell *cells;
+        size_t mask;
+
+        /* Next position producers reserve and next position the consumer reads (kept on separate cache lines). */
+        alignas(64) std::atomic<size_t> enqueue_position;
+        alignas(64) size_t dequeue_position;
+
+};
+
+# endif
\ No newline at end of file
@@ -0,0 +1,121 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "outgoing_message.hpp"
+
+# include "message_buffer.hpp"
+# include "../messaging.hpp"
+
+# include <string>
+# include <deque>
+
+# include <sys/uio.h>
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+outgoing_message::outgoing_message() {}
+
+outgoing_message::outgoing_message(const std::string &text) : payload(text) {}
+
+outgoing_message::outgoing_message(const message_handle &prefix, const message_handle &payload) : prefix(prefix), payload(payload) {}
+
+output_queue::output_queue() { this->offset = 0; }
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+const message_handle &outgoing_message::get_prefix() const { return this->prefix; }
+
+const message_handle &outgoing_message::get_payload() const { return this->payload; }
+
+size_t outgoing_message::size() const { return this->prefix.size() + this->payload.size(); }
+
+// ==============================================================================================================================================================
+// Queue ========================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Adds a message to be written inside a numbered frame. */
+void output_queue::push(const outgoing_message &message, uint32_t sequence, uint8_t flags) {
+
+    frame_header frame = { flags, (uint32_t)message.size(), sequence, 0 };
+
+    this->frames.emplace_back();
+    this->frames.back().message = message;
+    write_frame_header(this->frames.back().header, frame);
+
+}
+
+/* Returns if everything was written. */
+bool output_queue::empty() const { return this->frames.empty(); }
+
+/* Moves everything waiting to be written to another queue, appending it to what the other queue already has. */
+void output_queue::move_to(output_queue &other) {
+
+    if(other.frames.empty()) {
+        other.frames.swap(this->frames);
+        other.offset = this->offset;
+    } else {
+        for(auto iter = this->frames.begin(); iter != this->frames.end(); iter++)
+            other.frames.push_back(std::move(*iter));
+        this->frames.clear();
+    }
+
+    this->offset = 0;
+
+}
+
+/* Points the buffers to the data that was not written yet, returns how many buffers were used. */
+size_t output_queue::fill_iovecs(struct iovec *iovecs, size_t max_count) {
+
+    size_t count = 0;
+    size_t skip = this->offset;
+
+    for(auto iter = this->frames.begin(); iter != this->frames.end() && count < max_count; iter++) {
+
+        // Each frame is written as it's header followed by the parts of the message, the parts are never copied.
+        const char *parts[3] = { iter->header, iter->message.get_prefix().data(), iter->message.get_payload().data() };
+        size_t sizes[3] = { frame_header_size, iter->message.get_prefix().size(), iter->message.get_payload().size() };
+
+        for(int i = 0; i < 3 && count < max_count; i++) {
+
+            // Skips what was already written of the first frame.
+            if(skip >= sizes[i]) {
+                skip -= sizes[i];
+                continue;
+            }
+
+            iovecs[count].iov_base = (void*)(parts[i] + skip);
+            iovecs[count].iov_len = sizes[i] - skip;
+            skip = 0;
+            count++;
+
+        }
+
+    }
+
+    return count;
+
+}
+
+/* Marks an amount of bytes as written, releasing the messages that were written completely. */
+void output_queue::consume(size_t written) {
+
+    this->offset += written;
+
+    while(!this->frames.empty()) {
+
+        size_t frame_size = frame_header_size + this->frames.front().message.size();
+        if(this->offset < frame_size)
+            break;
+
+        this->offset -= frame_size;
+        this->frames.pop_front();
+
+    }
+
+}
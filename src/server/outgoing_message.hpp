@@ -0,0 +1,106 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef OUTGOING_MESSAGE_H
+# define OUTGOING_MESSAGE_H
+
+# include "message_buffer.hpp"
+# include "../messaging.hpp"
+
+# include <string>
+# include <deque>
+
+# include <sys/uio.h>
+
+// Max number of buffers written to a socket by a single system call.
+constexpr size_t max_output_iovecs = 64;
+
+// Message sent to a client, made of a prefix (i.e. who sent it) and a payload, both can be shared with other clients receiving the same message.
+class outgoing_message
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        outgoing_message();
+        outgoing_message(const std::string &text);
+        outgoing_message(const message_handle &prefix, const message_handle &payload);
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        // Getters for the prefix and the payload (empty if not set).
+        const message_handle &get_prefix() const;
+        const message_handle &get_payload() const;
+
+        // Returns the size of the whole message.
+        size_t size() const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Parts of the message, the prefix may be empty. */
+        message_handle prefix;
+        message_handle payload;
+
+};
+
+// Messages waiting to be written to a socket, each one with it's frame header, written with as few system calls as possible.
+class output_queue
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        output_queue();
+
+        // ==============================================================================================================================================================
+        // Queue ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Adds a message to be written inside a numbered frame. */
+        void push(const outgoing_message &message, uint32_t sequence, uint8_t flags = ff_Data);
+
+        /* Returns if everything was written. */
+        bool empty() const;
+
+        /* Moves everything waiting to be written to another queue, appending it to what the other queue already has. */
+        void move_to(output_queue &other);
+
+        /* Points the buffers to the data that was not written yet, returns how many buffers were used. */
+        size_t fill_iovecs(struct iovec *iovecs, size_t max_count);
+
+        /* Marks an amount of bytes as written, releasing the messages that were written completely. */
+        void consume(size_t written);
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* A message and it's frame header. */
+        struct output_frame {
+            char header[frame_header_size];
+            outgoing_message message;
+        };
+
+        /* Frames waiting to be written and how many bytes of the first one were already written. */
+        std::deque<output_frame> frames;
+        size_t offset;
+
+};
+
+# endif
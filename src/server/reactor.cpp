@@ -0,0 +1,780 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "reactor.hpp"
+
+# include "main_server.hpp"
+# include "connected_client.hpp"
+# include "uring.hpp"
+# include "../color.hpp"
+
+# include <iostream>
+# include <string>
+
+# include <map>
+# include <vector>
+# include <string>
+
+# include <thread>
+# include <mutex>
+# include <atomic>
+
+# include <chrono>
+
+# include <cstring>
+
+# include <errno.h>
+
+# include <sys/types.h>
+# include <sys/socket.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+
+# include <unistd.h>
+
+// Completion tags of the io_uring requests, the ones for clients are the address of their state with the lowest bit marking writes.
+constexpr uint64_t ud_Wakeup = 2;
+constexpr uint64_t ud_Accept = 4;
+constexpr uint64_t ud_Send_bit = 1;
+
+// What the timers of a client are used for.
+enum timer_type { tt_Retransmit, tt_Idle };
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Creates a reactor with it's epoll or io_uring instance, the loop is only started by spawn_handle. (the reactor takes ownership of the listener socket) */
+reactor::reactor(server *const server_instance, io_backend backend, int listener) : server_instance(server_instance), backend(backend) {
+
+    this->listener_fd = listener;
+    this->atmc_stop = false;
+    this->detached_clients = false;
+    this->reactor_status = 0;
+    this->epoll_fd = -1;
+    this->ring = nullptr;
+
+    // Creates the event used to wake the loop up.
+    this->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(this->wakeup_fd < 0) {
+        this->reactor_status = -1;
+        return;
+    }
+
+    // With io_uring the wake up event is read by the ring itself.
+    if(this->backend == ib_Io_uring) {
+        this->ring = new uring(uring_entries);
+        this->reactor_status = this->ring->get_status();
+        return;
+    }
+
+    // Creates the epoll instance.
+    this->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(this->epoll_fd < 0) {
+        this->reactor_status = -1;
+        return;
+    }
+
+    // Watches the wake up event, it's the only one registered without a client.
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    this->reactor_status = epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->wakeup_fd, &event);
+
+    // Watches the socket that accepts connections, it's identified by the address of it's descriptor.
+    if(this->reactor_status == 0 && this->listener_fd >= 0) {
+        event.events = EPOLLIN;
+        event.data.ptr = &this->listener_fd;
+        this->reactor_status = epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, this->listener_fd, &event);
+    }
+
+}
+
+reactor::~reactor() {
+
+    // Ensures the loop is not running.
+    this->stop();
+
+    // The clients that are still attached can't notify this reactor anymore.
+    for(auto iter = this->clients.begin(); iter != this->clients.end(); iter++)
+        iter->first->set_reactor(nullptr);
+
+    // Closes the file descriptors (closing the ring cancels any I/O still submitted).
+    if(this->ring != nullptr)
+        delete this->ring;
+    if(this->epoll_fd >= 0)
+        close(this->epoll_fd);
+    if(this->wakeup_fd >= 0)
+        close(this->wakeup_fd);
+    if(this->listener_fd >= 0)
+        close(this->listener_fd);
+
+}
+
+// ==============================================================================================================================================================
+// Reactor ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Returns the status of the reactor. */
+int reactor::get_status() const { return this->reactor_status; }
+
+/* Spawns the thread running this reactor's event loop. */
+void reactor::spawn_handle() { this->loop_handle = std::thread(&reactor::t_handle_events, this); }
+
+/* Stops the event loop and waits for it's thread to finish. */
+void reactor::stop() {
+
+    this->atmc_stop = true;
+    this->wake_up();
+
+    if(this->loop_handle.joinable())
+        this->loop_handle.join();
+
+}
+
+// ==============================================================================================================================================================
+// Mailbox ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Gives the ownership of a client's socket to this reactor. (thread-safe) */
+void reactor::attach(connected_client *client) { this->attach(std::vector<connected_client*>(1, client)); }
+
+/* Gives the ownership of a group of clients' sockets to this reactor, waking it up only once. (thread-safe) */
+void reactor::attach(const std::vector<connected_client*> &clients) {
+
+    // Only wakes the loop up if it was not already going to check the mailbox.
+    bool was_empty;
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->updating_mailbox.lock();
+    // ENTER CRITICAL REGION =======================================
+    was_empty = this->attaching_clients.empty();
+    this->attaching_clients.insert(this->attaching_clients.end(), clients.begin(), clients.end());
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->updating_mailbox.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    if(was_empty)
+        this->wake_up();
+
+}
+
+/* Tells the reactor a client has new messages waiting to be sent. (thread-safe) */
+void reactor::notify_output(connected_client *client) {
+
+    // Only wakes the loop up if it was not already going to check the mailbox.
+    bool was_empty;
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->updating_mailbox.lock();
+    // ENTER CRITICAL REGION =======================================
+    was_empty = this->output_clients.empty();
+    this->output_clients.push_back(client);
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->updating_mailbox.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    if(was_empty)
+        this->wake_up();
+
+}
+
+/* Tells the reactor a group of clients have new messages waiting to be sent, waking it up only once. (thread-safe) */
+void reactor::notify_output(const std::vector<connected_client*> &clients) {
+
+    // Only wakes the loop up if it was not already going to check the mailbox.
+    bool was_empty;
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->updating_mailbox.lock();
+    // ENTER CRITICAL REGION =======================================
+    was_empty = this->output_clients.empty();
+    this->output_clients.insert(this->output_clients.end(), clients.begin(), clients.end());
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->updating_mailbox.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    if(was_empty)
+        this->wake_up();
+
+}
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Returns the arena where the requests received by this reactor's clients are stored. (only used by the loop thread) */
+request_arena &reactor::get_request_arena() { return this->arena; }
+
+// ==============================================================================================================================================================
+// Event loop ===================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Thread running the event loop. */
+void reactor::t_handle_events() {
+
+    if(this->backend == ib_Io_uring)
+        this->run_uring();
+    else
+        this->run_epoll();
+
+}
+
+/* Event loop waiting for readiness with epoll. */
+void reactor::run_epoll() {
+
+    struct epoll_event events[max_reactor_events];
+
+    // Runs until the reactor is stopped.
+    while(!this->atmc_stop) {
+
+        // Sleeps until an event happens or until the next timer expires.
+        int event_count = epoll_wait(this->epoll_fd, events, max_reactor_events, this->get_timeout());
+        if(event_count < 0 && errno != EINTR) {
+            std::cerr << COLOR_BOLD_RED << "Reactor failed waiting for events!" << COLOR_DEFAULT << std::endl;
+            break;
+        }
+
+        // Handles the socket events.
+        for(int i = 0; i < event_count; i++) {
+
+            client_io *io = static_cast<client_io*>(events[i].data.ptr);
+
+            // The wake up event only needs to be reset, the mailbox is always checked bellow.
+            if(io == nullptr) {
+                while(read(this->wakeup_fd, &this->wakeup_value, sizeof(this->wakeup_value)) > 0);
+                continue;
+            }
+
+            // New connections on this reactor's socket.
+            if(events[i].data.ptr == &this->listener_fd) {
+                this->accept_connections();
+                continue;
+            }
+
+            // Reads new messages and writes pending ones.
+            if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                if(!io->client->handle_input()) {
+                    this->close_client(*io);
+                    continue;
+                }
+                this->update_idle_timer(*io);
+            }
+            this->send_output(*io);
+
+        }
+
+        // Handles what other threads sent.
+        this->handle_mailbox();
+
+        // Handles the timers that expired.
+        this->handle_timeouts();
+
+        // Tells the server about the clients detached on this iteration.
+        this->notify_detached();
+
+    }
+
+}
+
+/* Event loop submitting the reads and writes in batches to io_uring and waiting for their completion. */
+void reactor::run_uring() {
+
+    // Keeps a read of the wake up event and an accept on this reactor's socket submitted, when the ring is full they're submitted again on the next
+    // iterations (like the clients' reads and writes), and the loop doesn't sleep until everything was submitted again.
+    bool wakeup_submitted = false;
+    bool accept_submitted = false;
+
+    // Runs until the reactor is stopped.
+    while(!this->atmc_stop) {
+
+        if(!wakeup_submitted)
+            wakeup_submitted = this->submit_wakeup();
+        if(!accept_submitted && this->listener_fd >= 0)
+            accept_submitted = this->submit_accept();
+        this->resubmit_clients();
+
+        // Submits everything prepared on the last iteration with a single system call and sleeps until something completes or until the next timer expires.
+        bool can_sleep = wakeup_submitted && this->resubmitting_clients.empty();
+        if(this->ring->submit_and_wait(can_sleep ? 1 : 0, can_sleep ? this->get_timeout() : 0) < 0) {
+            std::cerr << COLOR_BOLD_RED << "Reactor failed waiting for completions!" << COLOR_DEFAULT << std::endl;
+            break;
+        }
+
+        // Handles every completion.
+        struct io_uring_cqe cqe;
+        while(this->ring->pop_cqe(cqe)) {
+
+            // Submits the read of the wake up event again, the mailbox is always checked bellow.
+            if(cqe.user_data == ud_Wakeup) {
+                wakeup_submitted = this->submit_wakeup();
+                continue;
+            }
+
+            // Adds the new client (the result is the accepted socket) and submits the next accept.
+            if(cqe.user_data == ud_Accept) {
+                if(cqe.res >= 0)
+                    this->server_instance->accept_client(cqe.res, this);
+                else if(cqe.res != -EAGAIN && cqe.res != -EINTR)
+                    std::cerr << COLOR_RED << "Unidentified connection error!" << COLOR_DEFAULT << std::endl;
+                accept_submitted = this->submit_accept();
+                continue;
+            }
+
+            client_io *io = (client_io*)(cqe.user_data & ~ud_Send_bit);
+
+            if(cqe.user_data & ud_Send_bit) { // A write finished.
+
+                io->sending = false;
+
+                if(cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN)
+                    this->close_client(*io);
+                else if(io->state == cs_Open) {
+
+                    // Continues writing what's left or takes the next messages.
+                    if(cqe.res > 0)
+                        io->send_queue.consume(cqe.res);
+                    if(!io->send_queue.empty())
+                        this->start_send(*io);
+                    else
+                        this->send_output(*io);
+
+                }
+
+            } else { // A read finished.
+
+                io->receiving = false;
+
+                if(cqe.res == 0 || (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN))
+                    this->close_client(*io);
+                else if(io->state == cs_Open) {
+
+                    // Handles the data and keeps reading.
+                    if(cqe.res > 0 && !io->client->receive(io->receive_buffer, cqe.res))
+                        this->close_client(*io);
+                    else {
+                        this->start_receive(*io);
+                        this->update_idle_timer(*io);
+                        this->send_output(*io);
+                    }
+
+                }
+
+            }
+
+            // Detaches closed clients as soon as nothing is using them.
+            if(io->state == cs_Closing && !io->receiving && !io->sending)
+                this->detach(*io);
+
+        }
+
+        // Handles what other threads sent.
+        this->handle_mailbox();
+
+        // Handles the timers that expired.
+        this->handle_timeouts();
+
+        // Tells the server about the clients detached on this iteration.
+        this->notify_detached();
+
+    }
+
+}
+
+/* Returns how long the loop can sleep before the next timer expires (in milliseconds, negative if there's no timer). */
+int reactor::get_timeout() const { return this->wheel.get_timeout(std::chrono::steady_clock::now()); }
+
+/* Handles the timers that expired, resending messages that were not acknowledged in time and checking idle clients. */
+void reactor::handle_timeouts() {
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    this->wheel.advance(now);
+
+    // Timers of clients detached while handling the others are destroyed with them, so they're never taken.
+    timer *expired;
+    while((expired = this->wheel.take_expired()) != nullptr) {
+
+        client_io &io = *static_cast<client_io*>(expired->owner);
+        if(io.state != cs_Open)
+            continue;
+
+        if(expired->type == tt_Idle) {
+            // Checks if the client is still there, it's shut down if the keepalive is never acknowledged.
+            io.client->send_keepalive();
+            this->update_idle_timer(io);
+            this->send_output(io);
+        } else if(io.client->handle_timeout(now))
+            this->send_output(io);
+        else // If the client could not confirm a message was received, shut it down.
+            this->close_client(io);
+
+    }
+
+}
+
+/* Handles what other threads sent to this reactor. */
+void reactor::handle_mailbox() {
+
+    std::vector<connected_client*> new_clients;
+    std::vector<connected_client*> new_output;
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->updating_mailbox.lock();
+    // ENTER CRITICAL REGION =======================================
+    /* Takes everything at once so the other threads wait as little as possible. */
+    new_clients.swap(this->attaching_clients);
+    new_output.swap(this->output_clients);
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->updating_mailbox.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    // Starts watching the new clients, messages may have been queued before they were attached.
+    for(auto iter = new_clients.begin(); iter != new_clients.end(); iter++)
+        if(this->watch(*iter))
+            new_output.push_back(*iter);
+
+    // Sends the new messages.
+    for(auto iter = new_output.begin(); iter != new_output.end(); iter++) {
+
+        // Clients that were detached in the meantime are ignored.
+        auto client_iter = this->clients.find(*iter);
+        if(client_iter == this->clients.end() || client_iter->second.state != cs_Open)
+            continue;
+
+        this->send_output(client_iter->second);
+
+    }
+
+}
+
+/* Wakes the server up if clients were detached, so it deletes them. */
+void reactor::notify_detached() {
+
+    if(!this->detached_clients)
+        return;
+
+    this->detached_clients = false;
+    this->server_instance->wake_dispatcher();
+
+}
+
+/* Accepts every pending connection on this reactor's socket. (epoll) */
+void reactor::accept_connections() {
+
+    std::vector<int> accepted;
+
+    // The server registers each batch of clients and gives them back to this reactor.
+    bool more = true;
+    while(more) {
+        accepted.clear();
+        more = server::accept_pending(this->listener_fd, accepted);
+        if(!accepted.empty())
+            this->server_instance->accept_clients(accepted, this);
+    }
+
+}
+
+/* Submits a read of the wake up event, returns false if the ring is full. (io_uring) */
+bool reactor::submit_wakeup() {
+
+    struct io_uring_sqe *sqe = this->ring->get_sqe();
+    if(sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = this->wakeup_fd;
+    sqe->addr = (uint64_t)&this->wakeup_value;
+    sqe->len = sizeof(this->wakeup_value);
+    sqe->user_data = ud_Wakeup;
+
+    return true;
+
+}
+
+/* Submits an accept on this reactor's socket, returns false if the ring is full. (io_uring) */
+bool reactor::submit_accept() {
+
+    struct io_uring_sqe *sqe = this->ring->get_sqe();
+    if(sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = this->listener_fd;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = ud_Accept;
+
+    return true;
+
+}
+
+/* Submits again the reads and writes that didn't fit on the ring, detaching the clients closed while they waited. (io_uring) */
+void reactor::resubmit_clients() {
+
+    if(this->resubmitting_clients.empty())
+        return;
+
+    // The clients that still don't fit are added back to the list.
+    std::vector<connected_client*> waiting;
+    waiting.swap(this->resubmitting_clients);
+
+    for(auto iter = waiting.begin(); iter != waiting.end(); iter++) {
+
+        auto client_iter = this->clients.find(*iter);
+        if(client_iter == this->clients.end())
+            continue;
+        client_io &io = client_iter->second;
+
+        bool receive = io.resubmit_receive;
+        bool send = io.resubmit_send;
+        io.resubmit_receive = false;
+        io.resubmit_send = false;
+
+        // Nothing else will complete for a closed client that was waiting, so it's detached here.
+        if(io.state != cs_Open) {
+            if(!io.receiving && !io.sending)
+                this->detach(io);
+            continue;
+        }
+
+        if(receive)
+            this->start_receive(io);
+        if(send && !io.send_queue.empty())
+            this->start_send(io);
+        else if(send)
+            this->send_output(io);
+
+    }
+
+}
+
+// ==============================================================================================================================================================
+// Clients ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Starts watching a new client's socket. */
+bool reactor::watch(connected_client *client) {
+
+    client_io &io = this->clients[client];
+    io.client = client;
+    io.watching_output = false;
+    io.state = cs_Open;
+    io.receiving = false;
+    io.sending = false;
+    io.resubmit_receive = false;
+    io.resubmit_send = false;
+
+    io.retransmit_timer.owner = &io;
+    io.retransmit_timer.type = tt_Retransmit;
+    io.idle_timer.owner = &io;
+    io.idle_timer.type = tt_Idle;
+    this->update_idle_timer(io);
+
+    client->set_reactor(this);
+
+    if(this->backend == ib_Io_uring) {
+
+        // The submitted reads wait for data themselves, so the socket is kept blocking.
+        this->start_receive(io);
+        return true;
+
+    } else {
+
+        // The socket was accepted non-blocking, so it's only registered.
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = &io;
+        if(epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, client->get_socket(), &event) == 0)
+            return true;
+
+    }
+
+    std::cerr << COLOR_RED << "Error watching client with socket " << client->get_socket() << "!" << COLOR_DEFAULT << std::endl;
+    this->close_client(io);
+    return false;
+
+}
+
+/* Writes the client's pending messages. */
+void reactor::send_output(client_io &io) {
+
+    if(this->backend == ib_Io_uring) {
+
+        // Only one write is submitted at a time, the messages queued meanwhile are written when it finishes.
+        if(!io.client->prepare_output()) {
+            this->close_client(io);
+            return;
+        }
+        if(!io.sending && !io.resubmit_send && io.client->take_output(io.send_queue))
+            this->start_send(io);
+
+    } else {
+
+        if(!io.client->handle_output()) {
+            this->close_client(io);
+            return;
+        }
+        this->update_interest(io);
+
+    }
+
+    // The messages sent may have changed when the next acknowledgement times out.
+    this->update_retransmit_timer(io);
+
+}
+
+/* Schedules a client's retransmission timer to it's first acknowledgement deadline, or cancels it if no message is waiting. */
+void reactor::update_retransmit_timer(client_io &io) {
+
+    std::chrono::steady_clock::time_point deadline;
+    if(io.client->get_ack_deadline(deadline))
+        this->wheel.schedule(io.retransmit_timer, deadline);
+    else
+        this->wheel.cancel(io.retransmit_timer);
+
+}
+
+/* Restarts the time a client can be idle, called when something is received from it. */
+void reactor::update_idle_timer(client_io &io) {
+
+    this->wheel.schedule(io.idle_timer, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(client_idle_time)));
+
+}
+
+/* Updates if a client's socket should be watched for writability. (epoll) */
+void reactor::update_interest(client_io &io) {
+
+    // Only changes the epoll registration if needed.
+    bool wants_output = io.client->wants_output();
+    if(io.watching_output == wants_output)
+        return;
+
+    struct epoll_event event;
+    event.events = wants_output ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    event.data.ptr = &io;
+    epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, io.client->get_socket(), &event);
+
+    io.watching_output = wants_output;
+
+}
+
+/* Submits a read of a client's socket, if the ring is full it's submitted again on the next iteration of the loop. (io_uring) */
+void reactor::start_receive(client_io &io) {
+
+    if(io.resubmit_receive || this->submit_receive(io))
+        return;
+
+    if(!io.resubmit_send)
+        this->resubmitting_clients.push_back(io.client);
+    io.resubmit_receive = true;
+
+}
+
+/* Submits a write of a client's socket, if the ring is full it's submitted again on the next iteration of the loop. (io_uring) */
+void reactor::start_send(client_io &io) {
+
+    if(io.resubmit_send || this->submit_send(io))
+        return;
+
+    if(!io.resubmit_receive)
+        this->resubmitting_clients.push_back(io.client);
+    io.resubmit_send = true;
+
+}
+
+/* Submits a read of a client's socket, returns false if the ring is full. (io_uring) */
+bool reactor::submit_receive(client_io &io) {
+
+    struct io_uring_sqe *sqe = this->ring->get_sqe();
+    if(sqe == nullptr)
+        return false;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = io.client->get_socket();
+    sqe->addr = (uint64_t)io.receive_buffer;
+    sqe->len = max_block_size;
+    sqe->user_data = (uint64_t)&io;
+
+    io.receiving = true;
+    return true;
+
+}
+
+/* Submits a write of a client's socket, returns false if the ring is full. (io_uring) */
+bool reactor::submit_send(client_io &io) {
+
+    struct io_uring_sqe *sqe = this->ring->get_sqe();
+    if(sqe == nullptr)
+        return false;
+
+    // Writes as many queued messages as possible with a single operation, the buffers stay valid until it completes.
+    memset(&io.send_message, 0, sizeof(io.send_message));
+    io.send_message.msg_iov = io.send_iovecs;
+    io.send_message.msg_iovlen = io.send_queue.fill_iovecs(io.send_iovecs, max_output_iovecs);
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = io.client->get_socket();
+    sqe->addr = (uint64_t)&io.send_message;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)&io | ud_Send_bit;
+
+    io.sending = true;
+    return true;
+
+}
+
+/* Closes the connection of a client, it's detached as soon as no I/O is using it. */
+void reactor::close_client(client_io &io) {
+
+    if(io.state == cs_Closing)
+        return;
+    io.state = cs_Closing;
+
+    // The client's timers are not needed anymore.
+    this->wheel.cancel(io.retransmit_timer);
+    this->wheel.cancel(io.idle_timer);
+
+    // Makes any submitted read or write finish, with io_uring the client is detached when their completions arrive.
+    shutdown(io.client->get_socket(), SHUT_RDWR);
+
+    if(this->backend == ib_Epoll)
+        this->detach(io);
+
+}
+
+/* Stops watching a client that has disconnected and hands it back to the server to be deleted. */
+void reactor::detach(client_io &io) {
+
+    connected_client *client = io.client;
+
+    if(this->backend == ib_Epoll)
+        epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, client->get_socket(), nullptr);
+
+    this->clients.erase(client);
+    client->set_reactor(nullptr);
+
+    // After this the reactor won't touch the client anymore and the server can delete it, it's woken up once for every client detached on this iteration.
+    client->atmc_kill = true;
+    this->detached_clients = true;
+
+}
+
+/* Wakes up the event loop. */
+void reactor::wake_up() {
+
+    uint64_t value = 1;
+    if(write(this->wakeup_fd, &value, sizeof(value)) < 0) {
+        // The counter is already full, so the loop will wake up anyways.
+    }
+
+}
\ No newline at end of file
@@ -0,0 +1,251 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef REACTOR_H
+# define REACTOR_H
+
+# include "uring.hpp"
+# include "outgoing_message.hpp"
+# include "timer_wheel.hpp"
+# include "request_arena.hpp"
+# include "../messaging.hpp"
+
+# include <map>
+# include <vector>
+# include <string>
+
+# include <thread>
+# include <mutex>
+# include <atomic>
+
+# include <sys/socket.h>
+# include <sys/uio.h>
+
+// Max number of events a reactor handles on each wake up.
+constexpr int max_reactor_events = 64;
+
+// Amount of entries on each reactor's io_uring submission ring.
+constexpr unsigned uring_entries = 1024;
+
+// Interfaces the reactors can use to do the clients' I/O.
+enum io_backend { ib_Epoll, ib_Io_uring };
+
+// Stages of a client's connection on a reactor: it's open from when it's attached until it's closed, then it waits on closing until no I/O is using it
+// and is detached (right away with epoll, when the submitted I/O completes with io_uring).
+enum connection_state { cs_Open, cs_Closing };
+
+// Headers for classes in other files that will be used bellow.
+class server;
+class connected_client;
+
+// Event loop that owns the sockets of a group of connected clients and handles all their I/O from a single thread.
+class reactor
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        reactor(server *const server_instance, io_backend backend, int listener);
+        ~reactor();
+
+        // ==============================================================================================================================================================
+        // Reactor ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the status of the reactor. */
+        int get_status() const;
+
+        /* Spawns the thread running this reactor's event loop. */
+        void spawn_handle();
+
+        /* Stops the event loop and waits for it's thread to finish. */
+        void stop();
+
+        // ==============================================================================================================================================================
+        // Mailbox ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Gives the ownership of a client's socket to this reactor. (thread-safe) */
+        void attach(connected_client *client);
+
+        /* Gives the ownership of a group of clients' sockets to this reactor, waking it up only once. (thread-safe) */
+        void attach(const std::vector<connected_client*> &clients);
+
+        /* Tells the reactor a client has new messages waiting to be sent. (thread-safe) */
+        void notify_output(connected_client *client);
+
+        /* Tells the reactor a group of clients have new messages waiting to be sent, waking it up only once. (thread-safe) */
+        void notify_output(const std::vector<connected_client*> &clients);
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the arena where the requests received by this reactor's clients are stored. (only used by the loop thread) */
+        request_arena &get_request_arena();
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Stores the I/O state of a client owned by this reactor. */
+        struct client_io {
+
+            connected_client *client;
+
+            /* Stage of the connection, the client's I/O is only handled while it's open. */
+            connection_state state;
+
+            /* If the socket is currently being watched for writability. (epoll) */
+            bool watching_output;
+
+            /* If a read or a write is currently submitted, a closing client waits for them to finish to be detached. (io_uring) */
+            bool receiving;
+            bool sending;
+
+            /* If a read or a write could not be submitted because the ring was full, it's submitted again after the next completions are taken. (io_uring) */
+            bool resubmit_receive;
+            bool resubmit_send;
+
+            /* Messages being written and the buffers pointing to them. (io_uring) */
+            output_queue send_queue;
+            struct iovec send_iovecs[max_output_iovecs];
+            struct msghdr send_message;
+
+            /* Buffer the submitted read writes to. (io_uring) */
+            char receive_buffer[max_block_size];
+
+            /* Expire when the first message waiting for an acknowledgement times out and when the client has been idle for too long. */
+            timer retransmit_timer;
+            timer idle_timer;
+
+        };
+
+        /* Stores an instance to the server this reactor belongs to. */
+        server *const server_instance;
+
+        /* Interface used to do the clients' I/O. */
+        const io_backend backend;
+
+        /* The epoll instance watching the client sockets (or the io_uring instance) and the event used to wake the loop up. */
+        int epoll_fd;
+        uring *ring;
+        int wakeup_fd;
+        uint64_t wakeup_value;
+
+        /* Socket this reactor accepts connections from on sharded mode, negative otherwise. */
+        int listener_fd;
+
+        /* Stores the status of the reactor. */
+        int reactor_status;
+
+        /* If the event loop should stop. */
+        std::atomic_bool atmc_stop;
+
+        /* Stores the thread running the event loop. */
+        std::thread loop_handle;
+
+        // Clients waiting to be attached and clients with new output, filled by other threads.
+        std::vector<connected_client*> attaching_clients;
+        std::vector<connected_client*> output_clients;
+        // Used to lock the mailbox when reading or writing to it.
+        std::mutex updating_mailbox;
+
+        /* Schedules the timers of the clients owned by this reactor, declared before them so it outlives their timers. (only used by the loop thread) */
+        timer_wheel wheel;
+
+        /* Clients owned by this reactor and their I/O state. (only used by the loop thread) */
+        std::map<connected_client*, client_io> clients;
+
+        /* Stores the requests received from the clients until the dispatcher executes them. (stored by the loop thread, released by the dispatcher) */
+        request_arena arena;
+
+        /* If clients were detached on the current iteration of the loop, the server is told about all of them at once. (only used by the loop thread) */
+        bool detached_clients;
+
+        /* Clients with a read or a write waiting to be submitted again. (only used by the loop thread) */
+        std::vector<connected_client*> resubmitting_clients;
+
+        // ==============================================================================================================================================================
+        // Event loop ===================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Thread running the event loop. */
+        void t_handle_events();
+
+        /* Event loop waiting for readiness with epoll. */
+        void run_epoll();
+
+        /* Event loop submitting the reads and writes in batches to io_uring and waiting for their completion. */
+        void run_uring();
+
+        /* Returns how long the loop can sleep before the next timer expires (in milliseconds, negative if there's no timer). */
+        int get_timeout() const;
+
+        /* Handles the timers that expired, resending messages that were not acknowledged in time and checking idle clients. */
+        void handle_timeouts();
+
+        /* Handles what other threads sent to this reactor. */
+        void handle_mailbox();
+
+        /* Wakes the server up if clients were detached, so it deletes them. */
+        void notify_detached();
+
+        /* Accepts every pending connection on this reactor's socket. (epoll) */
+        void accept_connections();
+
+        /* Submits a read of the wake up event, returns false if the ring is full. (io_uring) */
+        bool submit_wakeup();
+
+        /* Submits an accept on this reactor's socket, returns false if the ring is full. (io_uring) */
+        bool submit_accept();
+
+        /* Submits again the reads and writes that didn't fit on the ring, detaching the clients closed while they waited. (io_uring) */
+        void resubmit_clients();
+
+        // ==============================================================================================================================================================
+        // Clients ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Starts watching a new client's socket. */
+        bool watch(connected_client *client);
+
+        /* Writes the client's pending messages. */
+        void send_output(client_io &io);
+
+        /* Schedules a client's retransmission timer to it's first acknowledgement deadline, or cancels it if no message is waiting. */
+        void update_retransmit_timer(client_io &io);
+
+        /* Restarts the time a client can be idle, called when something is received from it. */
+        void update_idle_timer(client_io &io);
+
+        /* Updates if a client's socket should be watched for writability. (epoll) */
+        void update_interest(client_io &io);
+
+        /* Submits a read or a write of a client's socket, if the ring is full it's submitted again on the next iteration of the loop. (io_uring) */
+        void start_receive(client_io &io);
+        void start_send(client_io &io);
+
+        /* Submits a read or a write of a client's socket, returns false if the ring is full. (io_uring) */
+        bool submit_receive(client_io &io);
+        bool submit_send(client_io &io);
+
+        /* Closes the connection of a client, it's detached as soon as no I/O is using it. */
+        void close_client(client_io &io);
+
+        /* Stops watching a client that has disconnected and hands it back to the server to be deleted. */
+        void detach(client_io &io);
+
+        /* Wakes up the event loop. */
+        void wake_up();
+
+};
+
+# endif
\ No newline at end of file
@@ -5,7 +5,10 @@
 
 # include "request.hpp"
 
-# include <string>
+# include "client_table.hpp"
+# include "request_arena.hpp"
+
+# include <cstddef>
 
 // ==============================================================================================================================================================
 // Constructors/destructors =====================================================================================================================================
@@ -13,17 +16,21 @@
 
 request::request() {
 
-    this->origin_socket = -1;
+    this->origin = invalid_client_handle;
     this->r_type = rt_Invalid;
-    this->data = "/none";
+    this->data = "";
+    this->size = 0;
+    this->block = nullptr;
 
 }
 
-request::request(int origin_socket, request_type r_type, const std::string data) {
+request::request(client_handle origin, request_type r_type, const char *data, size_t size, arena_block *block) {
 
-    this->origin_socket = origin_socket;
+    this->origin = origin;
     this->r_type = r_type;
     this->data = data;
+    this->size = size;
+    this->block = block;
 
 }
 
@@ -31,8 +38,12 @@ request::request(int origin_socket, request_type r_type, const std::string data)
 // Getters ======================================================================================================================================================
 // ==============================================================================================================================================================
 
-int request::get_origin_socket() const { return this->origin_socket; }
+client_handle request::get_origin() const { return this->origin; }
 
 request_type request::get_type() const { return this->r_type; }
 
-std::string request::get_data() const { return this->data; }
\ No newline at end of file
+const char *request::get_data() const { return this->data; }
+
+size_t request::get_size() const { return this->size; }
+
+arena_block *request::get_block() const { return this->block; }
\ No newline at end of file
@@ -6,7 +6,10 @@
 # ifndef REQUEST_H
 # define REQUEST_H
 
-# include <string>
+# include "client_table.hpp"
+# include "request_arena.hpp"
+
+# include <cstddef>
 
 // Used to identify the type of a request, i.e. what command it should execute.
 enum request_type { rt_Invalid, rt_Send, rt_Nickname, rt_Join, rt_Admin_kick, rt_Admin_mute, rt_Admin_unmute, rt_Admin_whois};
@@ -21,20 +24,24 @@ class request
         // ==============================================================================================================================================================
 
         request();
-        request(int origin_socket, request_type r_type, const std::string data);
+        request(client_handle origin, request_type r_type, const char *data, size_t size, arena_block *block);
 
         // ==============================================================================================================================================================
         // Getters ======================================================================================================================================================
         // ==============================================================================================================================================================
 
-        // Getter for the origin socket.
-        int get_origin_socket() const;
+        // Getter for the handle of the client that made the request.
+        client_handle get_origin() const;
 
         // Getter for the request type.
         request_type get_type() const;
 
-        // Getter for the data.
-        std::string get_data() const;
+        // Getters for the data, stored on the arena of the reactor that received the request.
+        const char *get_data() const;
+        size_t get_size() const;
+
+        // Getter for the arena block the request must be released to after it's executed.
+        arena_block *get_block() const;
 
     private:
 
@@ -42,14 +49,16 @@ class request
         // Variables ====================================================================================================================================================
         // ==============================================================================================================================================================
 
-        /* The socket from which this request originated. */
-        int origin_socket;
+        /* The client from which this request originated. */
+        client_handle origin;
 
         /* Type of request. */
         request_type r_type;
 
-        // Data received for the request.
-        std::string data;
+        // Data received for the request (not copied, it points to the request stored on the arena block).
+        const char *data;
+        size_t size;
+        arena_block *block;
 
 };
 
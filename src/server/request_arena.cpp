@@ -0,0 +1,160 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "request_arena.hpp"
+
+# include <vector>
+# include <new>
+
+# include <atomic>
+
+# include <cstring>
+
+// Returns where the bytes of a block start, they're stored right after it.
+static char *block_data(arena_block *block) { return (char*)block + sizeof(arena_block); }
+
+// ==============================================================================================================================================================
+// Statics ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+std::atomic<uint64_t> request_arena::atmc_request_count(0);
+std::atomic<uint64_t> request_arena::atmc_block_count(0);
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+request_arena::request_arena() {
+
+    this->current = nullptr;
+    this->free_blocks = nullptr;
+    this->atmc_returned_blocks = nullptr;
+
+}
+
+request_arena::~request_arena() {
+
+    // Requests that were never executed are discarded with their blocks.
+    for(auto iter = this->blocks.begin(); iter != this->blocks.end(); iter++) {
+        (*iter)->~arena_block();
+        ::operator delete((void*)*iter);
+    }
+
+}
+
+// ==============================================================================================================================================================
+// Requests =====================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Copies a request to the arena, it must be released once it's no longer used. */
+request_payload request_arena::store(const char *data, size_t size) {
+
+    if(this->current == nullptr || this->current->capacity - this->current->used < size)
+        this->replace_block(size);
+
+    request_payload payload;
+    payload.data = block_data(this->current) + this->current->used;
+    payload.size = size;
+    payload.block = this->current;
+
+    memcpy(block_data(this->current) + this->current->used, data, size);
+    this->current->used += size;
+    this->current->atmc_references.fetch_add(1, std::memory_order_relaxed);
+
+    request_arena::atmc_request_count.fetch_add(1, std::memory_order_relaxed);
+
+    return payload;
+
+}
+
+/* Releases an amount of requests stored on the same block, the block goes back to it's arena after the last one. (thread-safe) */
+void request_arena::release(arena_block *block, unsigned count) {
+
+    if(block == nullptr || count == 0 || block->atmc_references.fetch_sub(count, std::memory_order_acq_rel) != count)
+        return;
+
+    // Gives the block back to it's arena, that takes the returned blocks only when it needs one.
+    request_arena *owner = block->owner;
+    block->next = owner->atmc_returned_blocks.load(std::memory_order_relaxed);
+    while(!owner->atmc_returned_blocks.compare_exchange_weak(block->next, block, std::memory_order_release, std::memory_order_relaxed));
+
+}
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+uint64_t request_arena::get_request_count() { return request_arena::atmc_request_count; }
+
+uint64_t request_arena::get_block_count() { return request_arena::atmc_block_count; }
+
+// ==============================================================================================================================================================
+// Blocks =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Replaces the current block by one with room for an amount of bytes. */
+void request_arena::replace_block(size_t size) {
+
+    // The arena's reference is released, the block returns once the requests on it are released.
+    if(this->current != nullptr)
+        request_arena::release(this->current);
+    this->current = nullptr;
+
+    // Takes every block returned by the other threads at once (nothing else pops from that list, so it's safe from ABA).
+    if(this->free_blocks == nullptr)
+        this->free_blocks = this->atmc_returned_blocks.exchange(nullptr, std::memory_order_acquire);
+
+    // Requests bigger than a block get one of their own.
+    if(size > request_arena_block_size)
+        this->current = this->allocate_block(size);
+
+    // Reuses a free block, blocks bigger than usual are freed as they were only needed by a single request.
+    while(this->free_blocks != nullptr && this->current == nullptr) {
+        arena_block *block = this->free_blocks;
+        this->free_blocks = block->next;
+        if(block->capacity == request_arena_block_size)
+            this->current = block;
+        else
+            this->free_block(block);
+    }
+
+    if(this->current == nullptr)
+        this->current = this->allocate_block(request_arena_block_size);
+
+    // Starts with the arena's reference.
+    this->current->used = 0;
+    this->current->next = nullptr;
+    this->current->atmc_references.store(1, std::memory_order_relaxed);
+
+}
+
+/* Allocates a new block and frees one, keeping the list of blocks. */
+arena_block *request_arena::allocate_block(size_t capacity) {
+
+    // The bytes are stored right after the block, so a block costs a single allocation.
+    void *memory = ::operator new(sizeof(arena_block) + capacity);
+    arena_block *block = new(memory) arena_block();
+    block->owner = this;
+    block->capacity = capacity;
+    block->index = this->blocks.size();
+    this->blocks.push_back(block);
+
+    request_arena::atmc_block_count.fetch_add(1, std::memory_order_relaxed);
+
+    return block;
+
+}
+
+void request_arena::free_block(arena_block *block) {
+
+    // Moves the last block to the position of the one freed.
+    this->blocks[block->index] = this->blocks.back();
+    this->blocks[block->index]->index = block->index;
+    this->blocks.pop_back();
+
+    block->~arena_block();
+    ::operator delete((void*)block);
+
+}
@@ -0,0 +1,108 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef REQUEST_ARENA_H
+# define REQUEST_ARENA_H
+
+# include <vector>
+
+# include <atomic>
+
+# include <cstddef>
+# include <cstdint>
+
+// Size of the blocks where requests are stored, requests bigger than this get a block of their own.
+constexpr size_t request_arena_block_size = 64 * 1024;
+
+// Headers for classes in other files that will be used bellow.
+class request_arena;
+
+// Block of memory of a request arena, it holds many requests and goes back to it's arena once all of them were released.
+struct arena_block {
+    request_arena *owner;
+    std::atomic<unsigned> atmc_references;
+    size_t capacity;
+    size_t used;
+    size_t index;
+    arena_block *next;
+};
+
+// Bytes of a request stored on an arena and the block they must be released to.
+struct request_payload {
+    const char *data;
+    size_t size;
+    arena_block *block;
+};
+
+// Stores the requests received by a reactor, copying each one after the last on a block, blocks are only allocated when every block is in use, so
+// after the first requests receiving one costs no allocation. The requests are released in bulk by the dispatcher after executing them, and a
+// block is reused by it's arena once every request on it was released. (only the reactor that owns it stores requests, releasing is thread-safe)
+class request_arena
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        request_arena();
+        ~request_arena();
+
+        request_arena(const request_arena&) = delete;
+        request_arena &operator=(const request_arena&) = delete;
+
+        // ==============================================================================================================================================================
+        // Requests =====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Copies a request to the arena, it must be released once it's no longer used. */
+        request_payload store(const char *data, size_t size);
+
+        /* Releases an amount of requests stored on the same block, the block goes back to it's arena after the last one. (thread-safe) */
+        static void release(arena_block *block, unsigned count = 1);
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns how many requests were stored since the server started and how many blocks were allocated to store them. (used for diagnostics) */
+        static uint64_t get_request_count();
+        static uint64_t get_block_count();
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Block where requests are being stored, it holds a reference of the arena until it's full. */
+        arena_block *current;
+
+        /* Every block allocated by this arena, freed when it's destroyed. */
+        std::vector<arena_block*> blocks;
+
+        /* Blocks that can be reused, the ones released by other threads are pushed to a list taken by the arena at once. */
+        arena_block *free_blocks;
+        std::atomic<arena_block*> atmc_returned_blocks;
+
+        /* Statistics shared by every arena. */
+        static std::atomic<uint64_t> atmc_request_count;
+        static std::atomic<uint64_t> atmc_block_count;
+
+        // ==============================================================================================================================================================
+        // Blocks =======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Replaces the current block by one with room for an amount of bytes. */
+        void replace_block(size_t size);
+
+        /* Allocates a new block and frees one, keeping the list of blocks. */
+        arena_block *allocate_block(size_t capacity);
+        void free_block(arena_block *block);
+
+};
+
+# endif
@@ -0,0 +1,82 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "rtt_estimator.hpp"
+
+# include <chrono>
+
+// Converts a time in seconds to the clock's duration.
+static std::chrono::steady_clock::duration seconds_to_duration(float seconds) {
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(seconds));
+}
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+rtt_estimator::rtt_estimator() {
+
+    // Until a round trip is measured the default time is used.
+    this->has_samples = false;
+    this->smoothed_rtt = std::chrono::steady_clock::duration::zero();
+    this->rtt_variation = std::chrono::steady_clock::duration::zero();
+    this->timeout = seconds_to_duration(acknowledge_wait_time);
+
+}
+
+// ==============================================================================================================================================================
+// Estimation ===================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Adds a measured round trip, it must come from a message that was sent only once (Karn's rule). */
+void rtt_estimator::add_sample(std::chrono::steady_clock::duration sample) {
+
+    if(!this->has_samples) { // The first measure is used directly.
+        this->smoothed_rtt = sample;
+        this->rtt_variation = sample / 2;
+        this->has_samples = true;
+    } else { // Next ones are smoothed (variation with 1/4 of the new measure and round trip with 1/8).
+        std::chrono::steady_clock::duration difference = (this->smoothed_rtt > sample) ? this->smoothed_rtt - sample : sample - this->smoothed_rtt;
+        this->rtt_variation = (3 * this->rtt_variation + difference) / 4;
+        this->smoothed_rtt = (7 * this->smoothed_rtt + sample) / 8;
+    }
+
+    // The timeout leaves room for four times the variation (at least the clock's granularity), this also undoes any back off.
+    std::chrono::steady_clock::duration margin = 4 * this->rtt_variation;
+    if(margin < seconds_to_duration(rtt_clock_granularity))
+        margin = seconds_to_duration(rtt_clock_granularity);
+    this->timeout = this->smoothed_rtt + margin;
+
+    this->clamp_timeout();
+
+}
+
+/* Doubles the time waited for an acknowledgement, called when one doesn't arrive in time. */
+void rtt_estimator::back_off() {
+
+    this->timeout *= 2;
+    this->clamp_timeout();
+
+}
+
+/* Keeps the timeout inside it's limits. */
+void rtt_estimator::clamp_timeout() {
+
+    if(this->timeout < seconds_to_duration(min_acknowledge_wait_time))
+        this->timeout = seconds_to_duration(min_acknowledge_wait_time);
+    else if(this->timeout > seconds_to_duration(max_acknowledge_wait_time))
+        this->timeout = seconds_to_duration(max_acknowledge_wait_time);
+
+}
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Returns the smoothed round trip time (zero if nothing was measured yet). */
+std::chrono::steady_clock::duration rtt_estimator::get_rtt() const { return this->smoothed_rtt; }
+
+/* Returns how long to wait for an acknowledgement before sending a message again. */
+std::chrono::steady_clock::duration rtt_estimator::get_timeout() const { return this->timeout; }
@@ -0,0 +1,71 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef RTT_ESTIMATOR_H
+# define RTT_ESTIMATOR_H
+
+# include <chrono>
+
+// Amount of time the server will wait before an attempt to send a message to a connected client fails, before any round trip was measured (in seconds).
+constexpr float acknowledge_wait_time = 0.400;
+// Limits for the time the server waits for an acknowledgement once it's calculated from the measured round trips (in seconds).
+constexpr float min_acknowledge_wait_time = 0.050;
+constexpr float max_acknowledge_wait_time = 10.0;
+// Granularity of the clock used to measure the round trips (in seconds).
+constexpr float rtt_clock_granularity = 0.001;
+
+// Estimates the round trip time of a connection from the time it takes for messages to be acknowledged and calculates how long to wait for an
+// acknowledgement before sending a message again (as described by RFC 6298).
+class rtt_estimator
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        rtt_estimator();
+
+        // ==============================================================================================================================================================
+        // Estimation ===================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Adds a measured round trip, it must come from a message that was sent only once (Karn's rule). */
+        void add_sample(std::chrono::steady_clock::duration sample);
+
+        /* Doubles the time waited for an acknowledgement, called when one doesn't arrive in time. */
+        void back_off();
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the smoothed round trip time (zero if nothing was measured yet). */
+        std::chrono::steady_clock::duration get_rtt() const;
+
+        /* Returns how long to wait for an acknowledgement before sending a message again. */
+        std::chrono::steady_clock::duration get_timeout() const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* If a round trip was already measured. */
+        bool has_samples;
+
+        /* Smoothed round trip time, it's variation and the current timeout. */
+        std::chrono::steady_clock::duration smoothed_rtt;
+        std::chrono::steady_clock::duration rtt_variation;
+        std::chrono::steady_clock::duration timeout;
+
+        /* Keeps the timeout inside it's limits. */
+        void clamp_timeout();
+
+};
+
+# endif
@@ -0,0 +1,54 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "../color.hpp"
+
+# include "server_reply.hpp"
+
+# include "outgoing_message.hpp"
+# include "message_buffer.hpp"
+
+# include <string>
+
+// Table with every reply that never changes, built the first time a reply is sent (static initialization of a local is thread-safe).
+struct server_reply_table {
+
+    message_handle prefix;
+    outgoing_message replies[sr_Count];
+
+    server_reply_table() : prefix(COLOR_MAGENTA + "server:") {
+
+        this->replies[sr_Pong] = outgoing_message(this->prefix, message_handle(COLOR_DEFAULT + " pong"));
+        this->replies[sr_Show_admin_commands] = outgoing_message("/show_admin_commands");
+        this->replies[sr_Hide_admin_commands] = outgoing_message("/hide_admin_commands");
+        this->replies[sr_Not_admin] = outgoing_message(this->prefix, message_handle(COLOR_DEFAULT + " you must be an admin to do that!"));
+        this->replies[sr_Invalid_command] = outgoing_message(this->prefix, message_handle(COLOR_DEFAULT + " invalid command or command parameters!"));
+        this->replies[sr_Busy] = outgoing_message(this->prefix, message_handle(COLOR_RED + " the server is busy, try again later!" + COLOR_DEFAULT));
+        this->replies[sr_Join_before_sending] = outgoing_message(this->prefix, message_handle(COLOR_RED + " you need to join a channel before sending messages!" + COLOR_DEFAULT));
+        this->replies[sr_Nickname_exists] = outgoing_message(this->prefix, message_handle(COLOR_RED + " this nickname already exists!" + COLOR_DEFAULT));
+        this->replies[sr_Invalid_nickname] = outgoing_message(this->prefix, message_handle(COLOR_RED + " this nickname is invalid! (It can't start with '#' or '&' and must not contain spaces or commas)" + COLOR_DEFAULT));
+        this->replies[sr_Invalid_channel_name] = outgoing_message(this->prefix, message_handle(COLOR_RED + " this channel name is invalid! (It can't start with '#' or '&' and must not contain spaces or commas)" + COLOR_DEFAULT));
+        this->replies[sr_Join_before_command] = outgoing_message(this->prefix, message_handle(COLOR_RED + " you need to join a channel before doing this!" + COLOR_DEFAULT));
+        this->replies[sr_Now_muted] = outgoing_message(this->prefix, message_handle(COLOR_YELLOW + " you are now muted on the current channel!" + COLOR_DEFAULT));
+        this->replies[sr_No_longer_muted] = outgoing_message(this->prefix, message_handle(COLOR_DEFAULT + " you are no longer muted on the current channel!"));
+
+    }
+
+};
+
+static const server_reply_table &get_table() {
+    static const server_reply_table table;
+    return table;
+}
+
+/* Returns a reply that never changes, rendered only once and shared by every client it's sent to. (thread-safe) */
+const outgoing_message &get_server_reply(server_reply reply) {
+    return get_table().replies[reply];
+}
+
+/* Returns a reply whose text changes, only the text is rendered, the "server:" prefix is shared with every other reply. (thread-safe) */
+outgoing_message make_server_reply(const std::string &text) {
+    return outgoing_message(get_table().prefix, message_handle(text));
+}
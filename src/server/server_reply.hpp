@@ -0,0 +1,38 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef SERVER_REPLY_H
+# define SERVER_REPLY_H
+
+# include "outgoing_message.hpp"
+
+# include <string>
+
+// Replies of the server whose text never changes.
+enum server_reply
+{
+    sr_Pong,
+    sr_Show_admin_commands,
+    sr_Hide_admin_commands,
+    sr_Not_admin,
+    sr_Invalid_command,
+    sr_Busy,
+    sr_Join_before_sending,
+    sr_Nickname_exists,
+    sr_Invalid_nickname,
+    sr_Invalid_channel_name,
+    sr_Join_before_command,
+    sr_Now_muted,
+    sr_No_longer_muted,
+    sr_Count
+};
+
+/* Returns a reply that never changes, rendered only once and shared by every client it's sent to. (thread-safe) */
+const outgoing_message &get_server_reply(server_reply reply);
+
+/* Returns a reply whose text changes, only the text is rendered, the "server:" prefix is shared with every other reply. (thread-safe) */
+outgoing_message make_server_reply(const std::string &text);
+
+# endif
@@ -0,0 +1,189 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef SPSC_RING_H
+# define SPSC_RING_H
+
+# include <utility>
+# include <algorithm>
+
+# include <atomic>
+
+# include <cstddef>
+
+/* Bounded wait-free queue where a single thread pushes and a single thread pops. Each side only writes it's own position and reads
+the other's, so neither of them ever waits on a lock or retries an operation. The items are kept on rings that start small and grow
+when they fill up: the producer links a ring twice as big (up to the capacity) and moves on to it, the consumer frees the old one
+after taking everything on it, so a queue that's rarely used never holds more than it's first ring. */
+template <typename T>
+class spsc_ring
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Creates a queue holding up to capacity items, the first ring holds initial_capacity of them (both rounded up to a power of two). */
+        spsc_ring(size_t capacity, size_t initial_capacity = 0) {
+
+            this->capacity = round_up(capacity);
+            if(initial_capacity == 0 || initial_capacity > this->capacity)
+                initial_capacity = this->capacity;
+
+            this->producer_ring = new ring(round_up(initial_capacity), 0);
+            this->consumer_ring = this->producer_ring;
+
+            this->tail.store(0, std::memory_order_relaxed);
+            this->head.store(0, std::memory_order_relaxed);
+            this->cached_head = 0;
+            this->cached_tail = 0;
+
+        }
+
+        ~spsc_ring() {
+
+            while(this->consumer_ring != nullptr) {
+                ring *next = this->consumer_ring->next.load(std::memory_order_relaxed);
+                delete this->consumer_ring;
+                this->consumer_ring = next;
+            }
+
+        }
+
+        spsc_ring(const spsc_ring&) = delete;
+        spsc_ring &operator=(const spsc_ring&) = delete;
+
+        /* Returns how many items the queue can hold. */
+        size_t get_capacity() const { return this->capacity; }
+
+        // ==============================================================================================================================================================
+        // Producer =====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Adds an item to the queue, returns false if the queue is full. (only called by the producer) */
+        bool push(const T &item) {
+
+            size_t position = this->tail.load(std::memory_order_relaxed);
+
+            // Only reads the consumer's position again when the queue or the current ring look full.
+            if(position - this->cached_head >= this->capacity || !this->producer_ring->has_room(position, this->cached_head)) {
+                this->cached_head = this->head.load(std::memory_order_acquire);
+                if(position - this->cached_head >= this->capacity)
+                    return false;
+            }
+
+            // Moves on to a bigger ring when the current one is full, it's linked before any item is stored on it.
+            if(!this->producer_ring->has_room(position, this->cached_head)) {
+                size_t size = std::min((this->producer_ring->mask + 1) * 2, this->capacity);
+                ring *next = new ring(size, position);
+                this->producer_ring->next.store(next, std::memory_order_release);
+                this->producer_ring = next;
+            }
+
+            // Stores the item and publishes it to the consumer.
+            this->producer_ring->items[position & this->producer_ring->mask] = item;
+            this->tail.store(position + 1, std::memory_order_release);
+
+            return true;
+
+        }
+
+        // ==============================================================================================================================================================
+        // Consumer =====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Takes up to max_count items at once, returns how many were taken. (only called by the consumer) */
+        template <typename Container>
+        size_t pop_batch(Container &taken, size_t max_count) {
+
+            size_t position = this->head.load(std::memory_order_relaxed);
+
+            // Only reads the producer's position again when the queue looks empty.
+            if(position == this->cached_tail) {
+                this->cached_tail = this->tail.load(std::memory_order_acquire);
+                if(position == this->cached_tail)
+                    return 0;
+            }
+
+            size_t count = this->cached_tail - position;
+            if(count > max_count)
+                count = max_count;
+
+            for(size_t i = 0; i < count; i++) {
+
+                // Frees the rings the producer has left once every item on them was taken.
+                ring *next = this->consumer_ring->next.load(std::memory_order_acquire);
+                while(next != nullptr && position + i >= next->first) {
+                    delete this->consumer_ring;
+                    this->consumer_ring = next;
+                    next = next->next.load(std::memory_order_acquire);
+                }
+
+                T &item = this->consumer_ring->items[(position + i) & this->consumer_ring->mask];
+                taken.push_back(std::move(item));
+                item = T();
+
+            }
+
+            // Frees the positions for the producer.
+            this->head.store(position + count, std::memory_order_release);
+
+            return count;
+
+        }
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Rings ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Items pushed from the first position on, until the producer moves on to the next ring. */
+        struct ring {
+
+            ring(size_t size, size_t first) : items(new T[size]), mask(size - 1), first(first), next(nullptr) {}
+            ~ring() { delete[] this->items; }
+
+            /* Returns if the item at the position fits, given how far the consumer has taken. (the consumer may still be on an older ring) */
+            bool has_room(size_t position, size_t consumed) const { return position - std::max(consumed, this->first) <= this->mask; }
+
+            T *items;
+            const size_t mask;
+            const size_t first;
+            std::atomic<ring*> next;
+
+        };
+
+        /* Returns the smallest power of two not smaller than the value. */
+        static size_t round_up(size_t value) {
+
+            size_t size = 1;
+            while(size < value)
+                size <<= 1;
+            return size;
+
+        }
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        size_t capacity;
+
+        /* Next position the producer writes, the last consumer position it saw and the ring it writes to. (kept on the producer's cache line) */
+        alignas(64) std::atomic<size_t> tail;
+        size_t cached_head;
+        ring *producer_ring;
+
+        /* Next position the consumer reads, the last producer position it saw and the ring it reads from. (kept on the consumer's cache line) */
+        alignas(64) std::atomic<size_t> head;
+        size_t cached_tail;
+        ring *consumer_ring;
+
+};
+
+# endif
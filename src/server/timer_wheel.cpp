@@ -0,0 +1,268 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "timer_wheel.hpp"
+
+# include <chrono>
+
+# include <cstdint>
+
+// Amount of bits of a tick used to choose a slot on each level.
+static const int slot_bits = 6;
+static_assert((1 << slot_bits) == timer_wheel_slots, "The amount of slots of the timer wheel must match the bits used to choose them.");
+
+// Mask of the bits used to choose a slot.
+static const uint64_t slot_mask = timer_wheel_slots - 1;
+
+// Duration of a tick of the wheel.
+static const std::chrono::steady_clock::duration tick_duration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(timer_wheel_tick));
+
+// ==============================================================================================================================================================
+// Timer ========================================================================================================================================================
+// ==============================================================================================================================================================
+
+timer::timer() {
+
+    this->owner = nullptr;
+    this->type = 0;
+
+    // Not scheduled, the timer is a list of it's own.
+    this->previous = this;
+    this->next = this;
+    this->wheel = nullptr;
+    this->expiry = 0;
+    this->level = 0;
+    this->slot = 0;
+
+}
+
+timer::~timer() {
+
+    // Makes sure the wheel never sees a destroyed timer.
+    if(this->wheel != nullptr)
+        this->wheel->cancel(*this);
+
+}
+
+/* Returns if the timer is scheduled or expired and not taken yet. */
+bool timer::is_scheduled() const { return this->wheel != nullptr; }
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+timer_wheel::timer_wheel() {
+
+    this->start = std::chrono::steady_clock::now();
+    this->current_tick = 0;
+
+    for(int level = 0; level < timer_wheel_levels; level++)
+        this->occupied[level] = 0;
+
+}
+
+timer_wheel::~timer_wheel() {
+
+    // Unschedules the timers left, so they don't try cancelling themselves on a destroyed wheel.
+    for(int level = 0; level < timer_wheel_levels; level++)
+        for(int slot = 0; slot < timer_wheel_slots; slot++)
+            while(this->slots[level][slot].next != &this->slots[level][slot])
+                this->cancel(*this->slots[level][slot].next);
+
+    while(this->expired.next != &this->expired)
+        this->cancel(*this->expired.next);
+
+}
+
+// ==============================================================================================================================================================
+// Timers =======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Schedules a timer to expire at a deadline, rescheduling it if it was already scheduled. */
+void timer_wheel::schedule(timer &scheduled, const std::chrono::steady_clock::time_point &deadline) {
+
+    if(scheduled.wheel != nullptr)
+        scheduled.wheel->cancel(scheduled);
+
+    // Rounds the deadline up to a tick, so timers never expire early.
+    uint64_t expiry = 0;
+    if(deadline > this->start)
+        expiry = (deadline - this->start + tick_duration - std::chrono::steady_clock::duration(1)) / tick_duration;
+
+    // Deadlines that already passed expire on the next tick.
+    if(expiry <= this->current_tick)
+        expiry = this->current_tick + 1;
+
+    scheduled.expiry = expiry;
+    scheduled.wheel = this;
+    this->insert(scheduled);
+
+}
+
+/* Cancels a timer, does nothing if it's not scheduled. */
+void timer_wheel::cancel(timer &cancelled) {
+
+    if(cancelled.wheel != this)
+        return;
+
+    this->unlink(cancelled);
+    cancelled.wheel = nullptr;
+
+}
+
+/* Advances the wheel to the current time, moving the timers that expired to a list where they can be taken from. */
+void timer_wheel::advance(const std::chrono::steady_clock::time_point &now) {
+
+    if(now <= this->start)
+        return;
+    uint64_t target_tick = (now - this->start) / tick_duration;
+
+    while(this->current_tick < target_tick) {
+
+        // Skips straight to the current time if there's no timer scheduled.
+        bool has_timers = false;
+        for(int level = 0; level < timer_wheel_levels && !has_timers; level++)
+            has_timers = this->occupied[level] != 0;
+        if(!has_timers) {
+            this->current_tick = target_tick;
+            break;
+        }
+
+        this->current_tick++;
+
+        // Moves down the timers of the levels that start a new slot on this tick, from the highest so they can go down more than one level.
+        int top_level = 0;
+        while(top_level + 1 < timer_wheel_levels && (this->current_tick & ((uint64_t(1) << (slot_bits * (top_level + 1))) - 1)) == 0)
+            top_level++;
+        for(int level = top_level; level > 0; level--)
+            this->cascade(level, (this->current_tick >> (slot_bits * level)) & slot_mask);
+
+        // Every timer on the current slot of the first level expires now.
+        timer &list = this->slots[0][this->current_tick & slot_mask];
+        while(list.next != &list) {
+            timer *expired_timer = list.next;
+            this->unlink(*expired_timer);
+            expired_timer->level = -1;
+            timer_wheel::append(this->expired, *expired_timer);
+        }
+
+    }
+
+}
+
+/* Takes an expired timer, returns null if there's none (timers cancelled or destroyed after expiring are never returned). */
+timer *timer_wheel::take_expired() {
+
+    if(this->expired.next == &this->expired)
+        return nullptr;
+
+    timer *taken = this->expired.next;
+    this->cancel(*taken);
+
+    return taken;
+
+}
+
+/* Returns how long the event loop can sleep until the next timer expires (in milliseconds, negative if no timer is scheduled). */
+int timer_wheel::get_timeout(const std::chrono::steady_clock::time_point &now) const {
+
+    // Expired timers must be handled right away.
+    if(this->expired.next != &this->expired)
+        return 0;
+
+    // Finds the closest tick where a timer expires or where timers must be moved down a level.
+    bool found = false;
+    uint64_t closest_tick = 0;
+    for(int level = 0; level < timer_wheel_levels; level++) {
+
+        if(this->occupied[level] == 0)
+            continue;
+
+        // Rotates the slots so the first bit is the slot after the current one, and finds the first one that's not empty.
+        uint64_t index = this->current_tick >> (slot_bits * level);
+        int rotation = (index + 1) & slot_mask;
+        uint64_t rotated = (rotation == 0) ? this->occupied[level] : (this->occupied[level] >> rotation) | (this->occupied[level] << (timer_wheel_slots - rotation));
+        uint64_t tick = (index + 1 + __builtin_ctzll(rotated)) << (slot_bits * level);
+
+        if(!found || tick < closest_tick) {
+            closest_tick = tick;
+            found = true;
+        }
+
+    }
+
+    if(!found)
+        return -1;
+
+    std::chrono::steady_clock::time_point wake_up = this->start + closest_tick * tick_duration;
+    if(wake_up <= now)
+        return 0;
+
+    // Rounds up so the loop doesn't wake up before the tick.
+    return std::chrono::duration_cast<std::chrono::milliseconds>(wake_up - now).count() + 1;
+
+}
+
+// ==============================================================================================================================================================
+// Lists ========================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Stores a timer on the slot for it's expiry tick. */
+void timer_wheel::insert(timer &inserted) {
+
+    // Chooses the lowest level whose range reaches the expiry tick.
+    uint64_t delta = inserted.expiry - this->current_tick;
+    int level = 0;
+    while(level + 1 < timer_wheel_levels && delta >= (uint64_t(1) << (slot_bits * (level + 1))))
+        level++;
+
+    // Timers too far away are kept at the end of the highest level, they expire early but their owner can schedule them again.
+    if(delta >= (uint64_t(1) << (slot_bits * (level + 1))))
+        inserted.expiry = this->current_tick + (uint64_t(1) << (slot_bits * (level + 1))) - 1;
+
+    inserted.level = level;
+    inserted.slot = (inserted.expiry >> (slot_bits * level)) & slot_mask;
+
+    timer_wheel::append(this->slots[level][inserted.slot], inserted);
+    this->occupied[level] |= uint64_t(1) << inserted.slot;
+
+}
+
+/* Removes a timer from the list it's stored on. */
+void timer_wheel::unlink(timer &removed) {
+
+    removed.previous->next = removed.next;
+    removed.next->previous = removed.previous;
+
+    // Marks the slot as empty if it was the last timer on it.
+    if(removed.level >= 0 && this->slots[removed.level][removed.slot].next == &this->slots[removed.level][removed.slot])
+        this->occupied[removed.level] &= ~(uint64_t(1) << removed.slot);
+
+    removed.previous = &removed;
+    removed.next = &removed;
+
+}
+
+/* Adds a timer to the end of a list. */
+void timer_wheel::append(timer &list, timer &appended) {
+
+    appended.previous = list.previous;
+    appended.next = &list;
+    list.previous->next = &appended;
+    list.previous = &appended;
+
+}
+
+/* Moves the timers of a slot to the levels bellow, as the slot's ticks are now close enough for them. */
+void timer_wheel::cascade(int level, int slot) {
+
+    timer &list = this->slots[level][slot];
+    while(list.next != &list) {
+        timer *moved = list.next;
+        this->unlink(*moved);
+        this->insert(*moved);
+    }
+
+}
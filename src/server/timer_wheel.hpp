@@ -0,0 +1,141 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef TIMER_WHEEL_H
+# define TIMER_WHEEL_H
+
+# include <chrono>
+
+# include <cstdint>
+
+// Duration of a tick of the timer wheel, timers expire on the first tick after their deadline (in seconds).
+constexpr float timer_wheel_tick = 0.010;
+// Amount of levels of the timer wheel and of slots on each level (each level's slot covers all the slots of the level bellow).
+constexpr int timer_wheel_levels = 4;
+constexpr int timer_wheel_slots = 64;
+
+// Headers for classes in other files that will be used bellow.
+class timer_wheel;
+
+// Timer stored inside the object it belongs to, so scheduling it never allocates, it's cancelled automatically when destroyed.
+class timer
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        timer();
+        ~timer();
+
+        timer(const timer&) = delete;
+        timer &operator=(const timer&) = delete;
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* What this timer belongs to and what it's used for, set by the owner to know what to do when it expires. */
+        void *owner;
+        int type;
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns if the timer is scheduled or expired and not taken yet. */
+        bool is_scheduled() const;
+
+    private:
+
+        friend class timer_wheel;
+
+        /* Neighbours on the list it's stored on. */
+        timer *previous;
+        timer *next;
+
+        /* Wheel it's scheduled on (null if not scheduled), the tick it expires on and where it's stored (level -1 is the expired list). */
+        timer_wheel *wheel;
+        uint64_t expiry;
+        int level;
+        int slot;
+
+};
+
+// Hierarchical timing wheel, scheduling and cancelling a timer are O(1) and the wheel tells how long the event loop can sleep until the next timer
+// expires. Each level has a slot for a range of ticks, when the lower level completes a turn, the timers of the next slot of the level above are moved
+// down, so each timer is only moved once per level. (not thread-safe, used by a single event loop)
+class timer_wheel
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        timer_wheel();
+        ~timer_wheel();
+
+        timer_wheel(const timer_wheel&) = delete;
+        timer_wheel &operator=(const timer_wheel&) = delete;
+
+        // ==============================================================================================================================================================
+        // Timers =======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Schedules a timer to expire at a deadline, rescheduling it if it was already scheduled. */
+        void schedule(timer &scheduled, const std::chrono::steady_clock::time_point &deadline);
+
+        /* Cancels a timer, does nothing if it's not scheduled. */
+        void cancel(timer &cancelled);
+
+        /* Advances the wheel to the current time, moving the timers that expired to a list where they can be taken from. */
+        void advance(const std::chrono::steady_clock::time_point &now);
+
+        /* Takes an expired timer, returns null if there's none (timers cancelled or destroyed after expiring are never returned). */
+        timer *take_expired();
+
+        /* Returns how long the event loop can sleep until the next timer expires (in milliseconds, negative if no timer is scheduled). */
+        int get_timeout(const std::chrono::steady_clock::time_point &now) const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* When the wheel was created and the last tick it has processed. */
+        std::chrono::steady_clock::time_point start;
+        uint64_t current_tick;
+
+        /* First node of the list of each slot (the lists are circular) and which slots are not empty on each level. */
+        timer slots[timer_wheel_levels][timer_wheel_slots];
+        uint64_t occupied[timer_wheel_levels];
+
+        /* Timers that expired and were not taken yet. */
+        timer expired;
+
+        // ==============================================================================================================================================================
+        // Lists ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Stores a timer on the slot for it's expiry tick. */
+        void insert(timer &inserted);
+
+        /* Removes a timer from the list it's stored on. */
+        void unlink(timer &removed);
+
+        /* Adds a timer to the end of a list. */
+        static void append(timer &list, timer &appended);
+
+        /* Moves the timers of a slot to the levels bellow, as the slot's ticks are now close enough for them. */
+        void cascade(int level, int slot);
+
+};
+
+# endif
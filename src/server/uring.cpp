@@ -0,0 +1,165 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "uring.hpp"
+
+# include <cstring>
+
+# include <errno.h>
+
+# include <linux/io_uring.h>
+# include <linux/time_types.h>
+
+# include <sys/mman.h>
+# include <sys/syscall.h>
+
+# include <unistd.h>
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Creates the ring and maps the memory shared with the kernel. */
+uring::uring(unsigned entries) {
+
+    this->ring_memory = MAP_FAILED;
+    this->sqes = (struct io_uring_sqe*)MAP_FAILED;
+    this->sqe_tail = 0;
+    this->ring_status = 0;
+
+    // Creates the ring.
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    this->ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if(this->ring_fd < 0) {
+        this->ring_status = -1;
+        return;
+    }
+
+    // Both rings must be in a single mapping and waiting with a timeout must be supported.
+    if(!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        this->ring_status = -1;
+        return;
+    }
+
+    // Maps the submission and completion rings.
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    this->ring_memory_size = (sq_size > cq_size) ? sq_size : cq_size;
+    this->ring_memory = mmap(nullptr, this->ring_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQ_RING);
+    if(this->ring_memory == MAP_FAILED) {
+        this->ring_status = -1;
+        return;
+    }
+
+    // Maps the submission entries.
+    this->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    this->sqes = (struct io_uring_sqe*)mmap(nullptr, this->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, this->ring_fd, IORING_OFF_SQES);
+    if(this->sqes == MAP_FAILED) {
+        this->ring_status = -1;
+        return;
+    }
+
+    // Gets the pointers to the ring fields.
+    char *memory = (char*)this->ring_memory;
+    this->sq_head = (unsigned*)(memory + params.sq_off.head);
+    this->sq_tail = (unsigned*)(memory + params.sq_off.tail);
+    this->sq_mask = (unsigned*)(memory + params.sq_off.ring_mask);
+    this->sq_array = (unsigned*)(memory + params.sq_off.array);
+    this->sq_entries = params.sq_entries;
+    this->cq_head = (unsigned*)(memory + params.cq_off.head);
+    this->cq_tail = (unsigned*)(memory + params.cq_off.tail);
+    this->cq_mask = (unsigned*)(memory + params.cq_off.ring_mask);
+    this->cqes = (struct io_uring_cqe*)(memory + params.cq_off.cqes);
+
+    this->sqe_tail = *this->sq_tail;
+
+}
+
+/* Unmaps the shared memory and closes the ring. */
+uring::~uring() {
+
+    if(this->sqes != MAP_FAILED)
+        munmap(this->sqes, this->sqes_size);
+    if(this->ring_memory != MAP_FAILED)
+        munmap(this->ring_memory, this->ring_memory_size);
+    if(this->ring_fd >= 0)
+        close(this->ring_fd);
+
+}
+
+// ==============================================================================================================================================================
+// Ring =========================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Returns the status of the ring, negative if io_uring is not available. */
+int uring::get_status() const { return this->ring_status; }
+
+/* Gets an empty submission entry, submitting the pending ones first if the ring is full. */
+struct io_uring_sqe *uring::get_sqe() {
+
+    // Submits what's pending if there's no space left.
+    if(this->sqe_tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) >= this->sq_entries)
+        this->submit_and_wait(0, 0);
+
+    if(this->sqe_tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE) >= this->sq_entries)
+        return nullptr;
+
+    // Takes the next entry and clears it.
+    unsigned index = this->sqe_tail & *this->sq_mask;
+    struct io_uring_sqe *sqe = &this->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    this->sq_array[index] = index;
+    this->sqe_tail++;
+
+    return sqe;
+
+}
+
+/* Submits every pending entry with a single system call and waits for completions (timeout in milliseconds, negative waits forever). */
+int uring::submit_and_wait(unsigned wait_count, int timeout) {
+
+    // Publishes the new entries to the kernel, the ones it didn't take on the last call are submitted again with them.
+    unsigned to_submit = this->sqe_tail - __atomic_load_n(this->sq_head, __ATOMIC_ACQUIRE);
+    __atomic_store_n(this->sq_tail, this->sqe_tail, __ATOMIC_RELEASE);
+
+    // Sets the time limit for the wait.
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (timeout % 1000) * 1000000;
+
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if(timeout >= 0)
+        arg.ts = (unsigned long long)&ts;
+
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    if(wait_count > 0)
+        flags |= IORING_ENTER_GETEVENTS;
+
+    int result = syscall(__NR_io_uring_enter, this->ring_fd, to_submit, wait_count, flags, &arg, sizeof(arg));
+
+    // Timing out or being interrupted is not an error, neither is the kernel being too busy to take the entries (they're kept until the completions
+    // are taken).
+    if(result < 0 && (errno == ETIME || errno == EINTR || errno == EBUSY || errno == EAGAIN))
+        return 0;
+
+    return result;
+
+}
+
+/* Takes the next completion, returns false if there's none. */
+bool uring::pop_cqe(struct io_uring_cqe &cqe) {
+
+    unsigned head = *this->cq_head;
+    if(head == __atomic_load_n(this->cq_tail, __ATOMIC_ACQUIRE))
+        return false;
+
+    cqe = this->cqes[head & *this->cq_mask];
+    __atomic_store_n(this->cq_head, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef URING_H
+# define URING_H
+
+# include <cstddef>
+
+# include <linux/io_uring.h>
+
+// Minimal io_uring instance used directly through system calls (the submission and completion rings are shared with the kernel).
+class uring
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        uring(unsigned entries);
+        ~uring();
+
+        // ==============================================================================================================================================================
+        // Ring =========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns the status of the ring, negative if io_uring is not available. */
+        int get_status() const;
+
+        /* Gets an empty submission entry, submitting the pending ones first if the ring is full. */
+        struct io_uring_sqe *get_sqe();
+
+        /* Submits every pending entry with a single system call and waits for completions (timeout in milliseconds, negative waits forever). */
+        int submit_and_wait(unsigned wait_count, int timeout);
+
+        /* Takes the next completion, returns false if there's none. */
+        bool pop_cqe(struct io_uring_cqe &cqe);
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* File descriptor of the ring and it's status. */
+        int ring_fd;
+        int ring_status;
+
+        /* Memory shared with the kernel. */
+        void *ring_memory;
+        size_t ring_memory_size;
+        struct io_uring_sqe *sqes;
+        size_t sqes_size;
+
+        /* Submission ring. */
+        unsigned *sq_head;
+        unsigned *sq_tail;
+        unsigned *sq_mask;
+        unsigned *sq_array;
+        unsigned sq_entries;
+
+        /* Submission entries taken by get_sqe that were not submitted yet. */
+        unsigned sqe_tail;
+
+        /* Completion ring. */
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned *cq_mask;
+        struct io_uring_cqe *cqes;
+
+};
+
+# endif
\ No newline at end of file
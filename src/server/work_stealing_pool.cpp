@@ -0,0 +1,223 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# include "work_stealing_pool.hpp"
+
+# include <vector>
+# include <deque>
+# include <functional>
+
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+
+# include <iterator>
+
+// Pool and queue of the current thread if it's a worker, so the tasks it adds go to it's own queue.
+static thread_local const work_stealing_pool *current_pool = nullptr;
+static thread_local unsigned current_queue = 0;
+
+// ==============================================================================================================================================================
+// Constructors/destructors =====================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Creates a pool, with no workers every task is run by the thread that adds it. */
+work_stealing_pool::work_stealing_pool(unsigned worker_count) {
+
+    this->atmc_queued = 0;
+    this->atmc_stop = false;
+
+    // A queue for each worker and one for the threads outside of the pool.
+    for(unsigned i = 0; i <= worker_count; i++)
+        this->queues.push_back(new task_queue());
+
+    for(unsigned i = 0; i < worker_count; i++)
+        this->workers.push_back(std::thread(&work_stealing_pool::t_work, this, i));
+
+}
+
+work_stealing_pool::~work_stealing_pool() {
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->sleeping.lock();
+    // ENTER CRITICAL REGION =======================================
+    this->atmc_stop = true;
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->sleeping.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    this->wake_up.notify_all();
+
+    for(auto iter = this->workers.begin(); iter != this->workers.end(); iter++)
+        iter->join();
+
+    for(auto iter = this->queues.begin(); iter != this->queues.end(); iter++)
+        delete *iter;
+
+}
+
+// ==============================================================================================================================================================
+// Tasks ========================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Runs a group of tasks in parallel, returns when all of them finished. */
+void work_stealing_pool::run(const std::vector<std::function<void()>> &tasks) {
+
+    if(tasks.empty())
+        return;
+
+    // Without workers (or with a single task) there's nothing to share.
+    if(this->workers.empty() || tasks.size() == 1) {
+        for(auto iter = tasks.begin(); iter != tasks.end(); iter++)
+            (*iter)();
+        return;
+    }
+
+    task_group group;
+    group.pending = tasks.size();
+    unsigned own = this->get_own_queue();
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    this->queues[own]->updating.lock();
+    // ENTER CRITICAL REGION =======================================
+    // Counts the tasks before they can be taken, so the workers never see less tasks than there are.
+    this->atmc_queued.fetch_add(tasks.size());
+    for(auto iter = tasks.begin(); iter != tasks.end(); iter++)
+        this->queues[own]->tasks.push_back(pool_task{ &(*iter), &group });
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    this->queues[own]->updating.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    // Wakes the sleeping workers up, the lock makes sure none of them is between checking the queued tasks and sleeping.
+    this->sleeping.lock();
+    this->sleeping.unlock();
+    this->wake_up.notify_all();
+
+    // Helps running the tasks of this group that were not taken yet, never tasks of other groups, so a task that adds a group only runs it's own
+    // group's tasks in the middle of it.
+    pool_task task;
+    while(this->take_from_group(own, &group, task))
+        this->execute(task);
+
+    // Sleeps until the tasks taken by the other threads finished.
+    std::unique_lock<std::mutex> lock(group.finishing);
+    group.finished.wait(lock, [&group]() { return group.pending == 0; });
+
+}
+
+/* Thread running the tasks of the pool. */
+void work_stealing_pool::t_work(unsigned index) {
+
+    current_pool = this;
+    current_queue = index;
+
+    while(!this->atmc_stop) {
+
+        if(this->run_next(index))
+            continue;
+
+        // Sleeps while there's no task to run.
+        std::unique_lock<std::mutex> lock(this->sleeping);
+        this->wake_up.wait(lock, [this]() { return this->atmc_stop || this->atmc_queued > 0; });
+
+    }
+
+}
+
+/* Runs a task from the given queue or stolen from another, returns false if there was none. (only called by the workers) */
+bool work_stealing_pool::run_next(unsigned own) {
+
+    pool_task task;
+    bool found = false;
+
+    // Takes the newest task of it's own queue first, then the oldest task of the other queues.
+    for(size_t i = 0; i < this->queues.size() && !found; i++) {
+
+        task_queue *queue = this->queues[(own + i) % this->queues.size()];
+
+        // --------------------------------------------------------------------------------------------------------------------------------------------------
+        // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+        queue->updating.lock();
+        // ENTER CRITICAL REGION =======================================
+        if(!queue->tasks.empty()) {
+            if(i == 0) {
+                task = queue->tasks.back();
+                queue->tasks.pop_back();
+            } else {
+                task = queue->tasks.front();
+                queue->tasks.pop_front();
+            }
+            found = true;
+        }
+        // EXIT CRITICAL REGION ========================================
+        // Exits the critical region, and opens the semaphore.
+        queue->updating.unlock();
+        // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    }
+
+    if(!found)
+        return false;
+
+    this->execute(task);
+
+    return true;
+
+}
+
+/* Takes a task of the given group that's still on the given queue, returns false if they were all taken. */
+bool work_stealing_pool::take_from_group(unsigned own, const task_group *group, pool_task &task) {
+
+    task_queue *queue = this->queues[own];
+    bool found = false;
+
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+    // Waits for the semaphore if necessary, and enters the critical region, closing the semaphore.
+    queue->updating.lock();
+    // ENTER CRITICAL REGION =======================================
+    // The group's tasks are usually the last ones, but the queue of the threads outside the pool may have other groups after them.
+    for(auto iter = queue->tasks.rbegin(); iter != queue->tasks.rend(); iter++) {
+        if(iter->group == group) {
+            task = *iter;
+            queue->tasks.erase(std::next(iter).base());
+            found = true;
+            break;
+        }
+    }
+    // EXIT CRITICAL REGION ========================================
+    // Exits the critical region, and opens the semaphore.
+    queue->updating.unlock();
+    // --------------------------------------------------------------------------------------------------------------------------------------------------
+
+    return found;
+
+}
+
+/* Runs a task taken from a queue and tells it's group when it was the last one. */
+void work_stealing_pool::execute(const pool_task &task) {
+
+    this->atmc_queued.fetch_sub(1);
+    (*task.function)();
+
+    // The group is only destroyed after it's thread sees no task left, which needs the lock, so it's still valid while it's held.
+    std::lock_guard<std::mutex> lock(task.group->finishing);
+    if(--task.group->pending == 0)
+        task.group->finished.notify_all();
+
+}
+
+// ==============================================================================================================================================================
+// Getters ======================================================================================================================================================
+// ==============================================================================================================================================================
+
+/* Returns how many threads the pool has (not counting the threads that add tasks). */
+unsigned work_stealing_pool::get_worker_count() const { return this->workers.size(); }
+
+/* Returns the queue of the current thread. */
+unsigned work_stealing_pool::get_own_queue() const { return (current_pool == this) ? current_queue : this->queues.size() - 1; }
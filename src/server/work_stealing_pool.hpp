@@ -0,0 +1,112 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+# ifndef WORK_STEALING_POOL_H
+# define WORK_STEALING_POOL_H
+
+# include <vector>
+# include <deque>
+# include <functional>
+
+# include <thread>
+# include <mutex>
+# include <condition_variable>
+# include <atomic>
+
+# include <cstddef>
+
+// Fixed group of threads running groups of tasks. Each thread has it's own queue, it runs the tasks it added from the back of it's queue and, when it has
+// nothing left, steals tasks from the front of the others' queues. The thread that adds a group of tasks helps running the tasks of that group that were
+// not taken yet and then sleeps until the others finished, so a task can add a group of it's own (fork-join). (thread-safe)
+class work_stealing_pool
+{
+
+    public:
+
+        // ==============================================================================================================================================================
+        // Constructors/destructors =====================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Creates a pool, with no workers every task is run by the thread that adds it. */
+        work_stealing_pool(unsigned worker_count);
+        ~work_stealing_pool();
+
+        work_stealing_pool(const work_stealing_pool&) = delete;
+        work_stealing_pool &operator=(const work_stealing_pool&) = delete;
+
+        // ==============================================================================================================================================================
+        // Tasks ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Runs a group of tasks in parallel, returns when all of them finished. The calling thread only runs tasks of this group while it waits, so
+        a task that runs a group never has unrelated tasks run in the middle of it. */
+        void run(const std::vector<std::function<void()>> &tasks);
+
+        // ==============================================================================================================================================================
+        // Getters ======================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Returns how many threads the pool has (not counting the threads that add tasks). */
+        unsigned get_worker_count() const;
+
+    private:
+
+        // ==============================================================================================================================================================
+        // Variables ====================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Tasks added together, the thread that added them sleeps on the event until none is left. */
+        struct task_group {
+            size_t pending;
+            std::mutex finishing;
+            std::condition_variable finished;
+        };
+
+        /* A task and the group it belongs to. */
+        struct pool_task {
+            const std::function<void()> *function;
+            task_group *group;
+        };
+
+        /* Tasks added by a thread, the last queue is shared by the threads outside of the pool. */
+        struct task_queue {
+            std::mutex updating;
+            std::deque<pool_task> tasks;
+        };
+        std::vector<task_queue*> queues;
+
+        /* The pool's threads. */
+        std::vector<std::thread> workers;
+
+        /* Amount of tasks waiting on the queues, the workers sleep while there's none (counted before the tasks are added, so it never goes bellow zero). */
+        std::atomic<size_t> atmc_queued;
+        std::mutex sleeping;
+        std::condition_variable wake_up;
+
+        /* If the workers should stop. */
+        std::atomic_bool atmc_stop;
+
+        // ==============================================================================================================================================================
+        // Tasks ========================================================================================================================================================
+        // ==============================================================================================================================================================
+
+        /* Thread running the tasks of the pool. */
+        void t_work(unsigned index);
+
+        /* Runs a task from the given queue or stolen from another, returns false if there was none. (only called by the workers) */
+        bool run_next(unsigned own);
+
+        /* Takes a task of the given group that's still on the given queue, returns false if they were all taken. */
+        bool take_from_group(unsigned own, const task_group *group, pool_task &task);
+
+        /* Runs a task taken from a queue and tells it's group when it was the last one. */
+        void execute(const pool_task &task);
+
+        /* Returns the queue of the current thread. */
+        unsigned get_own_queue() const;
+
+};
+
+# endif
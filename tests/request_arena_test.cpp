@@ -0,0 +1,128 @@
+// Authors:
+// Abner Eduardo Silveira Santos - NUSP 10692012
+// João Pedro Uchôa Cavalcante - NUSP 10801169
+// Luís Eduardo Rozante de Freitas Pereira - NUSP 10734794
+
+// Checks that storing and queueing requests does no heap allocation per request: once the arena has it's blocks, storing requests, queueing them,
+// taking them in batches and releasing them in bulk never calls operator new. It covers how the requests are kept between the reactors and the
+// dispatcher, not how they're parsed or executed: executing a request still allocates (a message allocates the buffer shared by it's targets and
+// the lists of targets of each reactor, and the commands that take a name copy it to a string).
+
+# include "../src/server/request_arena.hpp"
+# include "../src/server/request.hpp"
+# include "../src/server/mpsc_queue.hpp"
+
+# include <iostream>
+# include <string>
+
+# include <vector>
+# include <new>
+
+# include <atomic>
+
+# include <cstdlib>
+# include <cstring>
+
+// Amount of allocations made through operator new since the program started.
+static std::atomic<uint64_t> allocation_count(0);
+
+// ==============================================================================================================================================================
+// Allocation counting ==========================================================================================================================================
+// ==============================================================================================================================================================
+
+// Only the plain forms allocate and free, every other form forwards to them, so the new and delete that end up being called always match (they're
+// not inlined, so the compiler doesn't see malloc and free in place of the array forms that forward to them).
+__attribute__((noinline)) void *operator new(size_t size) {
+    allocation_count++;
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if(memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void operator delete(void *memory) noexcept { std::free(memory); }
+
+void *operator new[](size_t size) { return ::operator new(size); }
+void *operator new(size_t size, const std::nothrow_t&) noexcept { try { return ::operator new(size); } catch(...) { return nullptr; } }
+void *operator new[](size_t size, const std::nothrow_t&) noexcept { try { return ::operator new(size); } catch(...) { return nullptr; } }
+
+void operator delete[](void *memory) noexcept { ::operator delete(memory); }
+void operator delete(void *memory, size_t) noexcept { ::operator delete(memory); }
+void operator delete[](void *memory, size_t) noexcept { ::operator delete(memory); }
+
+// ==============================================================================================================================================================
+// Test =========================================================================================================================================================
+// ==============================================================================================================================================================
+
+// Amount of batches and requests on each batch, enough to go through the first block many times.
+constexpr size_t batch_count = 1000;
+constexpr size_t batch_size = 256;
+
+// Stores a batch of requests and queues them, like a reactor does, then takes them and releases them grouped by block, like the dispatcher does.
+static bool run_batch(request_arena &arena, mpsc_queue<request> &queue, std::vector<request> &batch, const std::string &message) {
+
+    for(size_t i = 0; i < batch_size; i++) {
+        request_payload payload = arena.store(message.data(), message.size());
+        if(!queue.push(request(1, rt_Send, payload.data + 6, payload.size - 6, payload.block)))
+            return false;
+    }
+
+    batch.clear();
+    if(queue.pop_batch(batch, batch_size) != batch_size)
+        return false;
+
+    for(auto iter = batch.begin(); iter != batch.end();) {
+        arena_block *block = iter->get_block();
+        unsigned count = 0;
+        for(; iter != batch.end() && iter->get_block() == block; iter++)
+            count++;
+        request_arena::release(block, count);
+    }
+
+    return true;
+
+}
+
+int main() {
+
+    request_arena arena;
+    mpsc_queue<request> queue(batch_size);
+    std::vector<request> batch;
+    batch.reserve(batch_size);
+    std::string message = "/send " + std::string(100, 'x');
+
+    // The first batches allocate the arena's blocks: the first one, and a second one when the first is full while requests of the batch being stored
+    // are still on it, after that the blocks are reused as they're released, so the warm up stores enough requests to go through both of them.
+    for(size_t stored = 0; stored <= 2 * request_arena_block_size; stored += batch_size * message.size()) {
+        if(!run_batch(arena, queue, batch, message)) {
+            std::cerr << "FAILED: the requests of the warm up were not queued!" << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t allocations_before = allocation_count;
+    uint64_t blocks_before = request_arena::get_block_count();
+
+    for(size_t i = 0; i < batch_count; i++) {
+        if(!run_batch(arena, queue, batch, message)) {
+            std::cerr << "FAILED: the requests of batch " << i << " were not queued!" << std::endl;
+            return 1;
+        }
+    }
+
+    uint64_t allocations = allocation_count - allocations_before;
+    uint64_t blocks = request_arena::get_block_count() - blocks_before;
+    uint64_t bytes = batch_count * batch_size * message.size();
+
+    std::cout << batch_count * batch_size << " requests (" << bytes / 1024 << " KB) stored, queued and released: " << allocations << " allocations, "
+    << blocks << " new blocks" << std::endl;
+
+    if(allocations != 0 || blocks != 0) {
+        std::cerr << "FAILED: the requests' path allocated memory!" << std::endl;
+        return 1;
+    }
+
+    std::cout << "OK" << std::endl;
+    return 0;
+
+}